@@ -1,36 +1,41 @@
 #include "asm.hpp"
 
+#include <map>
 #include <set>
 
-#define ldr(x) (x == A ? "ldar " : "ldbr ")
+#define ldr(x) (x == A ? "ldar" : "ldbr")
 
 using namespace std;
 
-set<string> which_intrinsics_to_include;
-
-void include_intrinsic(string name)
+// the intrinsics called anywhere in the program, and the ones they depend on
+set<string> ASMProgram::intrinsics_to_be_included()
 {
-    which_intrinsics_to_include.insert(name);
-}
+    set<string> result;
+    for (ASMFunction* func : functions) {
+	for (ASMNode* node : func->body) {
+	    ASMCall* call = dynamic_cast<ASMCall*>(node);
+	    if (call == nullptr || !intrinsics->provides(call->target))
+		continue;
 
-set<string> get_intrinsics_to_be_included()
-{
-    return which_intrinsics_to_include;
+	    result.insert(call->target);
+	    for (string dependency : intrinsics->find(call->target)->dependencies)
+		result.insert(dependency);
+	}
+    }
+    return result;
 }
 
 // takes a GP register and puts it in the aluregs
 void emit_register_fetch(ASMRegister* reg,
 			 Register alureg,
-			 ostream& out)
+			 MachineCode& out)
 {
     string load_op = ldr(alureg); // either ldar or ldbr
-    out << "\t" << load_op;
-    reg->emit(out);
-    out << endl;
+    out.op(load_op, MOperand::reg(reg->name));
 }
 
 // takes a stack value and puts it in the aluregs
-	void emit_stack_fetch(ASMStack *stk, Register alureg, ostream &out)
+void emit_stack_fetch(ASMStack *stk, Register alureg, MachineCode& out)
 {
     // Thank god I wrote this comment!
     // this is asymmetric w.r.t. the two ALU regs because the builtin
@@ -39,44 +44,45 @@ void emit_register_fetch(ASMRegister* reg,
     
     if (alureg == B)
     {
-	asmc("ldra %r12", "save the A register");
+	out.op("ldra", MOperand::reg(r12), "save the A register");
 	stk->emit(out);
-	asmc("ldmaa", "load the value from calculated address in stack frame");
-	asmc("ldra %r13", "auxiliary");
-	asmc("ldbr %r13", "transfer to B register");
-	asmc("ldar %r12", "put original value back in A register");
+	out.op("ldmaa", "load the value from calculated address in stack frame");
+	out.op("ldra", MOperand::reg(r13), "auxiliary");
+	out.op("ldbr", MOperand::reg(r13), "transfer to B register");
+	out.op("ldar", MOperand::reg(r12), "put original value back in A register");
     }
     else if (alureg == A)
     {
 	stk->emit(out);
-	asmc("ldmaa", "load the value from calculated address in stack frame");
+	out.op("ldmaa", "load the value from calculated address in stack frame");
     }
 }
 
+// stores are the last thing an ASM node does, so A and B are dead
+// afterwards and need not be restored
 void emit_stack_store(ASMStack* stk,
 		      Register alureg,
-		      ostream& out)
+		      MachineCode& out)
 {
-    asmc("ldra %r12", "save the A register");
-    asmc("ldrb %r13", "save the B register");
+    Register out_reg = (alureg == A ? r12 : r13);
 
-    stk->emit(out);		// stack addr will now be in the A register
-
-    string out_reg = (alureg == A ? "%r12" : "%r13");
+    if (alureg == A)
+	out.op("ldra", MOperand::reg(r12), "save the A register");
+    else
+	out.op("ldrb", MOperand::reg(r13), "save the B register");
 
-    asmc("ldmra " + out_reg, "load the value to the stack");
+    stk->emit(out);		// stack addr will now be in the A register
 
-    asmc("ldar %r12", "restore old values");
-    asmc("ldbr %r13", "restore old values");
+    out.op("ldmra", MOperand::reg(out_reg), "load the value to the stack");
 }
 
 // loads an operand (immediate, register, stack location) into B register
-void emit_ldb_operand(ASMOperand* src, ostream& out)
+void emit_ldb_operand(ASMOperand* src, MachineCode& out)
 {
     switch(src->type)
     {
     case IMMEDIATE:
-	asmc("ldbi " + ((ASMImmediate*)src)->get_val(), "immediate"); // directly load into B reg
+	out.op("ldbi", MOperand::imm(((ASMImmediate*)src)->val), "immediate"); // directly load into B reg
 	break;
     case REGISTER:
 	emit_register_fetch((ASMRegister*)src, B, out); // load operand into B
@@ -88,7 +94,7 @@ void emit_ldb_operand(ASMOperand* src, ostream& out)
 }
 
 // loads an operand (immediate, register, stack location) into A register
-void emit_lda_operand(ASMOperand* src, ostream& out)
+void emit_lda_operand(ASMOperand* src, MachineCode& out)
 {
     switch(src->type)
     {
@@ -96,6 +102,8 @@ void emit_lda_operand(ASMOperand* src, ostream& out)
 	src->emit(out);		// directly load into A reg
 	break;
     case REGISTER:
+	if (((ASMRegister*)src)->name == A)
+	    break;		// chained from the previous instruction
 	emit_register_fetch((ASMRegister*)src, A, out); // load operand into A
 	break;
     case MEMORY:
@@ -105,14 +113,12 @@ void emit_lda_operand(ASMOperand* src, ostream& out)
 }
 
 // stores B register into an operand (register or stack location) 
-void emit_stb_operand(ASMOperand* dest, ostream& out)
+void emit_stb_operand(ASMOperand* dest, MachineCode& out)
 {
     switch(dest->type)
     {
     case REGISTER:
-	out << "\t" << "ldrb ";
-	dest->emit(out);
-	out << endl;
+	out.op("ldrb", MOperand::reg(((ASMRegister*)dest)->name));
 	
 	break;
     case MEMORY:
@@ -122,14 +128,14 @@ void emit_stb_operand(ASMOperand* dest, ostream& out)
 }
 
 // stores A register into an operand (register or stack location) 
-void emit_sta_operand(ASMOperand* dest, ostream& out)
+void emit_sta_operand(ASMOperand* dest, MachineCode& out)
 {
     switch(dest->type)
     {
     case REGISTER:
-	out << "\t" << "ldra ";
-	dest->emit(out);
-	out << endl;
+	if (((ASMRegister*)dest)->name == A)
+	    break;		// the next instruction takes it from A
+	out.op("ldra", MOperand::reg(((ASMRegister*)dest)->name));
 	
 	break;
     case MEMORY:
@@ -137,3 +143,138 @@ void emit_sta_operand(ASMOperand* dest, ostream& out)
 	break;
     }
 }
+
+// where an instruction leaves its result in A, nullptr if it does not
+static ASMOperand** result_in_a(ASMNode* node)
+{
+    if (dynamic_cast<ASMCmp*>(node))
+	return nullptr;
+
+    if (ASMBinary* binary = dynamic_cast<ASMBinary*>(node))
+	return &binary->dest;
+    if (ASMUnary* unary = dynamic_cast<ASMUnary*>(node))
+	return &unary->dest;
+    if (ASMLoad* load = dynamic_cast<ASMLoad*>(node))
+	return &load->dest;
+    return nullptr;
+}
+
+// the operand an instruction loads into A first, nullptr if there is none
+static ASMOperand** loaded_into_a(ASMNode* node)
+{
+    if (ASMBinary* binary = dynamic_cast<ASMBinary*>(node))
+	return &binary->src1;
+    if (ASMLoad* load = dynamic_cast<ASMLoad*>(node))
+	return &load->src;
+    if (ASMPush* push = dynamic_cast<ASMPush*>(node))
+	return &push->op;
+    return nullptr;
+}
+
+void chain_through_accumulator(vector<ASMNode*>& body, int num_vregs)
+{
+    vector<int> reads(num_vregs, 0), writes(num_vregs, 0);
+    for (ASMNode* node : body) {
+	vector<ASMOperand*> read_ops, write_ops;
+	node->operands(read_ops, write_ops);
+	for (ASMOperand* op : read_ops) {
+	    if (op->type == PSUEDO)
+		reads[((ASMPsuedoReg*)op)->reg]++;
+	}
+	for (ASMOperand* op : write_ops) {
+	    if (op->type == PSUEDO)
+		writes[((ASMPsuedoReg*)op)->reg]++;
+	}
+    }
+
+    for (int i = 0; i + 1 < body.size(); i++) {
+	ASMOperand** result = result_in_a(body[i]);
+	ASMOperand** next_src = loaded_into_a(body[i + 1]);
+	if (result == nullptr || next_src == nullptr
+	    || (*result)->type != PSUEDO || (*next_src)->type != PSUEDO)
+	    continue;
+
+	int reg = ((ASMPsuedoReg*)*result)->reg;
+	if (((ASMPsuedoReg*)*next_src)->reg != reg || reads[reg] != 1 || writes[reg] != 1)
+	    continue;
+
+	*result = new ASMRegister(A);
+	*next_src = new ASMRegister(A);
+    }
+}
+
+bool elide_frame(vector<ASMNode*>& body, FrameLayout& frame)
+{
+    if (frame.local_count != 0)
+	return false;
+
+    for (ASMNode* node : body) {
+	vector<ASMOperand*> reads, writes;
+	node->operands(reads, writes);
+	reads.insert(reads.end(), writes.begin(), writes.end());
+	for (ASMOperand* op : reads) {
+	    if (op->type == MEMORY)
+		((ASMStack*)op)->from_rsp = true;
+	}
+
+	if (ASMReturn* ret = dynamic_cast<ASMReturn*>(node))
+	    ret->frameless = true;
+    }
+    return true;
+}
+
+// the fewest instructions that build factor * x from x by doubling,
+// adding x and subtracting x, 0x10000 wraps around to 0
+static int sequence_length(int factor, map<int, int>& memo)
+{
+    if (factor == 1)
+	return 0;
+
+    auto it = memo.find(factor);
+    if (it != memo.end())
+	return it->second;
+
+    int length;
+    if (factor % 2 == 0)
+	length = sequence_length(factor / 2, memo) + 1;
+    else
+	length = min(sequence_length(factor - 1, memo), sequence_length(factor + 1, memo)) + 1;
+
+    memo[factor] = length;
+    return length;
+}
+
+static void build_sequence(int factor, map<int, int>& memo, vector<string>& sequence)
+{
+    if (factor == 1)
+	return;
+
+    if (factor % 2 == 0)
+    {
+	build_sequence(factor / 2, memo, sequence);
+	sequence.push_back("shl");
+    }
+    else if (sequence_length(factor - 1, memo) <= sequence_length(factor + 1, memo))
+    {
+	build_sequence(factor - 1, memo, sequence);
+	sequence.push_back("add");
+    }
+    else
+    {
+	build_sequence(factor + 1, memo, sequence);
+	sequence.push_back("sub");
+    }
+}
+
+vector<string> multiply_sequence(int factor, bool& negate)
+{
+    const int negate_length = 4;	// B = A through a register, then 0 - B
+
+    map<int, int> memo;
+    int positive = factor & 0xffff, negative = 0x10000 - positive;
+    negate = sequence_length(negative, memo) + negate_length < sequence_length(positive, memo);
+
+    vector<string> sequence;
+    build_sequence(negate ? negative : positive, memo, sequence);
+    return sequence;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <ostream>
 #include <vector>
@@ -10,14 +11,23 @@
 #include <set>
 
 #include "mcc.hpp"
+#include "intrinsics.hpp"
+#include "regalloc.hpp"
+#include "machine.hpp"
 
 using namespace std;
 
-#define com(c) out << "\t;; " << c << endl
-#define asm(x) out << left << "\t" << setw(20) << x << endl
-#define asmc(x,c) out << left << "\t" << setw(20) << x << " ; " << c << endl
-#define asml(x) out << left << x << ":" << endl 
-#define com_self() stringstream stream; pretty_print(stream); com(stream.str())
+#define com(c) out.comment(c)
+#define asml(x) out.label(x)
+#define com_self() stringstream stream; pretty_print(stream); com(trim_newline(stream.str())); out.blank()
+
+// pretty_print ends its lines, comments are one line
+inline string trim_newline(string text)
+{
+    while (!text.empty() && text.back() == '\n')
+	text.pop_back();
+    return text;
+}
 
 
 
@@ -38,14 +48,9 @@ enum ASMOperandType
     PSUEDO
 };
 
-bool is_function_intrinsic(string name);
-vector<string> get_intrinsic_dependencies(string name);
-void include_intrinsic(string name);
-set<string> get_intrinsics_to_be_included();
+class ASMOperand;
 
-string uniq_label();
-
-class ASMNode
+class ASMNode : public PoolNode
 {
 public:
     virtual void pretty_print(ostream& out)
@@ -53,9 +58,12 @@ public:
 	out << "ASM Node" << endl;
     }
 
-    virtual void legalize(unordered_map<string, int>& temps, int& local_count) {}
+    virtual void legalize(FrameLayout& frame) {}
+
+    // the operands read and written, for the register allocator
+    virtual void operands(vector<ASMOperand*>& reads, vector<ASMOperand*>& writes) {}
 
-    virtual void emit(ostream& out) { out << "asm_node" << endl; }
+    virtual void emit(MachineCode& out) { com("asm_node"); }
 };
 
 class ASMInstruction : public ASMNode
@@ -66,7 +74,7 @@ public:
 	out << "ASM Instruction" << endl;
     }
 
-    virtual void emit(ostream& out) { out << "asm_instruction" << endl; }
+    virtual void emit(MachineCode& out) { com("asm_instruction"); }
 };
 
 class ASMAllocateStack : public ASMInstruction
@@ -80,14 +88,14 @@ public:
 	out << "AllocateStack(" << size << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
-	asm("ldas");
-	asm("ldbi " + to_string(size));
-	asm("sub");
-	asm("ldsa");
-	out << endl;
+	out.op("ldas");
+	out.op("ldbi", MOperand::imm(size));
+	out.op("sub");
+	out.op("ldsa");
+	out.blank();
     }
 };
 
@@ -102,14 +110,14 @@ public:
 	out << "DeAllocateStack(" << size << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
-	asm("ldas");
-	asm("ldbi " + to_string(size));
-	asm("add");
-	asm("ldsa");
-	out << endl;
+	out.op("ldas");
+	out.op("ldbi", MOperand::imm(size));
+	out.op("add");
+	out.op("ldsa");
+	out.blank();
     }
 };
 
@@ -117,37 +125,38 @@ class ASMCall : public ASMInstruction
 {
 public:
     string target;
+    int register_args;		// intrinsics read their args from r1 onwards
 
-    ASMCall(string _target) : target(_target) {}
+    ASMCall(string _target, int _register_args = 0) : target(_target), register_args(_register_args) {}
 
     virtual void pretty_print(ostream& out)
     {
 	out << "Call(" + target + ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 	
-	asmc("subr", "function call");
-	asmc("subr2 " + target, "function call part 2");
-
-	// if it is intrinsic function, 
-        if (is_function_intrinsic(target))
-	{
-	    include_intrinsic(target);
-
-	    vector<string> deps = get_intrinsic_dependencies(target);
-	    for (string dependency : deps)
-	    {
-		include_intrinsic(dependency);
-	    }
-        }
+	out.op("subr", "function call");
+	out.op("subr2", MOperand::label_ref(target), "function call part 2");
 
-        out << endl;
+        out.blank();
     }
 };
 
+// A temporary that is only read by the next instruction, as the operand
+// it loads into A first, is kept in A: both operands become Reg(A), so
+// the result is neither stored nor loaded again
+void chain_through_accumulator(vector<ASMNode*>& body, int num_vregs);
+
+// A function with all of its vregs in registers needs no frame: rbp is
+// neither saved nor set up, the stack operands left (the arg slots) are
+// addressed from rsp and the returns skip the epilogue. rsp only moves
+// around a call, so it is the same at every place one is read. Returns
+// true if the frame is elided
+bool elide_frame(vector<ASMNode*>& body, FrameLayout& frame);
+
 class ASMFunction : public ASMNode
 {
 public:
@@ -155,12 +164,15 @@ public:
     vector<ASMNode*> body;
     ASMAllocateStack* stack_space;
     int num_args;
+    int num_vregs;
+    bool frameless = false;
 
-    ASMFunction(string _name, vector<ASMNode*> _body)
+    ASMFunction(string _name, vector<ASMNode*> _body, int _num_vregs)
     :
 	body(_body),
 	name(_name),
-	stack_space(nullptr)
+	stack_space(nullptr),
+	num_vregs(_num_vregs)
     {}
 
     virtual void pretty_print(ostream& out)
@@ -179,27 +191,33 @@ public:
 	}
     }
 
-    virtual void legalize(unordered_map<string, int>& temps)
+    virtual void legalize()
     {
-	int local_count = 0;
+	FrameLayout frame(num_vregs); // vregs are per function, so is this table
+	chain_through_accumulator(body, num_vregs);
+	allocate_frame(body, frame);
 	
 	for (ASMNode* i : body) {
-	    i->legalize(temps, local_count);
+	    i->legalize(frame);
 	}
 	
-	stack_space = new ASMAllocateStack(local_count); // save how many locations we need to reserve on the stack
+	stack_space = new ASMAllocateStack(frame.local_count); // save how many locations we need to reserve on the stack
+	frameless = elide_frame(body, frame);
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {	
-	out << name << ":" << endl;
+	asml(name);
 
-	com("Function prologue");
-	asmc("pushr %r15", "save current rbp to stack");
-	asmc("pushr2 %r15", "save current rbp to stack part 2");
-	asmc("ldrs %r15", "move rsp to rbp");
+	if (!frameless)
+	{
+	    com("Function prologue");
+	    out.op("pushr", MOperand::reg(r15), "save current rbp to stack");
+	    out.op("pushr2", MOperand::reg(r15), "save current rbp to stack part 2");
+	    out.op("ldrs", MOperand::reg(r15), "move rsp to rbp");
 	
-	stack_space->emit(out);	// function prologue
+	    stack_space->emit(out);	// function prologue
+	}
 	
 	for (ASMNode* i : body) {
 
@@ -216,7 +234,7 @@ public:
 	    i->pretty_print(type_of_node);
 	    if (name == "main" && type_of_node.str() == "Return()\n")
 	    {
-		asmc("hlt", "halt as this is a return point of the main function");
+		out.op("hlt", "halt as this is a return point of the main function");
 	    }
 	    
 	    i->emit(out);
@@ -229,8 +247,13 @@ class ASMProgram : public ASMNode
 {
 public:
     vector<ASMFunction*> functions;
+    const IntrinsicLibrary* intrinsics;
     
-    ASMProgram(vector<ASMFunction*> _functions) : functions(_functions) {}
+    ASMProgram(vector<ASMFunction*> _functions, const IntrinsicLibrary* _intrinsics)
+	:
+	functions(_functions),
+	intrinsics(_intrinsics)
+    {}
 
     virtual void pretty_print(ostream& out)
     {
@@ -241,39 +264,57 @@ public:
 	}
     }
 
-    virtual void legalize(unordered_map<string, int>& temps)
+    virtual void legalize()
     {
-	int locals_count;	// this is useless, just to make the function signature fit
 	for (ASMFunction* func : functions) {
-	    func->legalize(temps);
+	    func->legalize();
 	}
     }
 
-    virtual void emit(ostream& out)
+    set<string> intrinsics_to_be_included();
+
+    // the startup code and the end of the program are also what the
+    // linker wraps around separately compiled objects
+    static void emit_startup(MachineCode& out)
     {
 	com("program");
-	asmc("lds 0xfffe", "initialize stack pointer");
-	asmc("ldrs %r15", "initialize rbp");
-	asmc("jmp main", "jump to the main function label (not call)");
+	out.op("lds", MOperand::imm(0xfffe), "initialize stack pointer");
+	out.op("ldrs", MOperand::reg(r15), "initialize rbp");
+	out.op("jmp", MOperand::label_ref("main"), "jump to the main function label (not call)");
+    }
+
+    static void emit_end(MachineCode& out)
+    {
+	out.op("hlt", "halt at the end of program");
+    }
 
+    void emit_functions(MachineCode& out)
+    {
 	for (ASMFunction* func : functions) {
 	    func->emit(out);
 	}
-	
-	asmc("hlt", "halt at the end of program");
+    }
 
+    virtual void emit(MachineCode& out)
+    {
+	emit_startup(out);
+	emit_functions(out);
+	emit_end(out);
+    }
+
+    // the intrinsics are kept as the text they were written in
+    void emit_intrinsics(ostream& out)
+    {
         out << ";; Intrinsic functions are inserted after this point" << endl << endl;
 	
 	// include assembly for intrinsic functions
-	set<string> intrinsics = get_intrinsics_to_be_included();
-	for (string intrinsic : intrinsics)
+	for (string intrinsic : intrinsics_to_be_included())
 	{
 	    out << endl;
 	    out << ";; --------- Intrinsic " + intrinsic + "---------" << endl;
 	    out << endl;
 	
-	    string code = read_file("/usr/lib/mcc/intrinsics/" + intrinsic + ".s");
-	    out << code << endl;
+	    out << intrinsics->find(intrinsic)->source << endl;
 	}
 	
     }
@@ -291,28 +332,28 @@ public:
 	out << "ASM Operand";
     }
 
-    virtual ASMOperand* legalize_op(unordered_map<string, int>& temps, int& local_count)
+    virtual ASMOperand* legalize_op(FrameLayout& frame)
     {
 	return this;
     }
 
-    virtual void emit_location(ostream& out)
-    {
-	out << "location" << endl;
-    }
 };
 
 void emit_lda_operand(ASMOperand* src,
-		      ostream& out);
+		      MachineCode& out);
 
 void emit_ldb_operand(ASMOperand* src,
-		      ostream& out);
+		      MachineCode& out);
 
 void emit_sta_operand(ASMOperand* dest,
-		      ostream& out);
+		      MachineCode& out);
 
 void emit_stb_operand(ASMOperand* dest,
-		      ostream& out);
+		      MachineCode& out);
+
+// the shl, add and sub that take A from x to x * factor, with x in B
+// throughout. If negate is set they give -x * factor, which is cheaper
+vector<string> multiply_sequence(int factor, bool& negate);
 
 
 class ASMPush : public ASMNode
@@ -329,19 +370,24 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void legalize(unordered_map<string, int>& temps, int& local_count)
+    virtual void legalize(FrameLayout& frame)
     {
-	op = op->legalize_op(temps, local_count);
+	op = op->legalize_op(frame);
     }
 
-    virtual void emit(ostream& out)
+    virtual void operands(vector<ASMOperand*>& reads, vector<ASMOperand*>& writes)
+    {
+	reads.push_back(op);
+    }
+
+    virtual void emit(MachineCode& out)
     {
 	com("Push an operand to stack");
 	emit_lda_operand(op, out);
-	asmc("ldra %r14", "load the value to be pushed into r14");
-	asmc("pushr %r14", "push value in r14");
-	asm("pushr2 %r14");
-	out << endl;
+	out.op("ldra", MOperand::reg(r14), "load the value to be pushed into r14");
+	out.op("pushr", MOperand::reg(r14), "push value in r14");
+	out.op("pushr2", MOperand::reg(r14));
+	out.blank();
     }
     
 };
@@ -358,14 +404,9 @@ public:
 	out << "Imm(" << val << ")";
     }
     
-    virtual void emit(ostream& out)
-    {
-	asmc("ldai " + to_string(val), "immediate");
-    }
-
-    virtual string get_val()
+    virtual void emit(MachineCode& out)
     {
-	return to_string(val);
+	out.op("ldai", MOperand::imm(val), "immediate");
     }
 };
 
@@ -380,21 +421,19 @@ public:
 	out << "Reg(" << name << ")";
     }
 
-    virtual void emit(ostream& out)
-    {
-	out << "%r" << name;
-    }
 };
 
 // takes a GP register and puts it in the aluregs
 void emit_register_fetch(ASMRegister* reg,
 			 Register alureg,
-			 ostream& out);
+			 MachineCode& out);
 
 class ASMStack : public ASMOperand
 {
 public:
-    int offset;
+    int offset;			// from rbp
+    bool from_rsp = false;	// in a function without a frame, where rsp is rbp + 1
+
     ASMStack(int _offset) : ASMOperand(MEMORY), offset(_offset) {}
 
     virtual void pretty_print(ostream& out)
@@ -402,55 +441,64 @@ public:
 	out << "Stack(" << offset << ")";
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com("Stack");
-	asmc("ldar %r15", "load rsp into A register");
+	int offset = this->offset;
+	if (from_rsp)
+	{
+	    out.op("ldas", "no frame, the address is from rsp");
+	    offset++;
+	}
+	else
+	    out.op("ldar", MOperand::reg(r15), "load rsp into A register");
 
 	if (offset == 0)	// no further action is needed
 	{
 	    com("As offset is 0, no further action is needed");
-	    out << endl;
+	    out.blank();
 	    return;
 	}
 
-	asmc("ldbi " + to_string(abs(offset)), "load offset into B reg");
+	out.op("ldbi", MOperand::imm(abs(offset)), "load offset into B reg");
 
 	if (offset > 0)
-	    asmc("sub", " now address is stored in A reg, can be acessed using ldmaa");
+	    out.op("sub", " now address is stored in A reg, can be acessed using ldmaa");
 	else
-	    asmc("add", " now address is stored in A reg, can be acessed using ldmaa");
+	    out.op("add", " now address is stored in A reg, can be acessed using ldmaa");
 	
-	out << endl;
+	out.blank();
     }
 };
 
 // takes a stack value and puts it in the aluregs
 void emit_stack_fetch(ASMStack* stk,
 		      Register alureg,
-		      ostream& out);
+		      MachineCode& out);
 
 class ASMPsuedoReg : public ASMOperand
 {
 public:
-    string ident;
-    ASMPsuedoReg(string _ident) : ASMOperand(PSUEDO), ident(_ident) {}
+    int reg;			// the TACKY vreg
+    ASMPsuedoReg(int _reg) : ASMOperand(PSUEDO), reg(_reg) {}
 
     virtual void pretty_print(ostream& out)
     {
-	out << "Psuedo(" << ident << ")";
+	out << "Psuedo(v" << reg << ")";
     }
 
-    virtual ASMOperand* legalize_op(unordered_map<string, int>& temps, int& local_count)
+    virtual ASMOperand* legalize_op(FrameLayout& frame)
     {
-        if (temps.count(ident) == 0)
+	if (frame.registers[reg] != -1)
+	    return new ASMRegister((Register)frame.registers[reg]);
+
+        if (frame.slots[reg] == -1)
 	{
-	    temps[ident] = local_count; // the size will give the offset for the stack
-	    local_count++;		 // add one to the locals count
-	    return new ASMStack(temps[ident]);
+	    frame.slots[reg] = frame.local_count; // the size will give the offset for the stack
+	    frame.local_count++;		 // add one to the locals count
 	}
 
-	return new ASMStack(temps[ident]);
+	return new ASMStack(frame.slots[reg]);
     }
 };
 
@@ -475,24 +523,32 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void legalize(unordered_map<string, int>& temps, int& local_count)
+    virtual void legalize(FrameLayout& frame)
+    {
+	dest = dest->legalize_op(frame);
+	src = src->legalize_op(frame);
+    }
+
+    virtual void operands(vector<ASMOperand*>& reads, vector<ASMOperand*>& writes)
     {
-	dest = dest->legalize_op(temps, local_count);
-	src = src->legalize_op(temps, local_count);
+	reads.push_back(src);
+	writes.push_back(dest);
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 	emit_lda_operand(src, out);
 	emit_sta_operand(dest, out);
-	out << endl;
+	out.blank();
     }
 };
 
 class ASMReturn : public ASMInstruction
 {
 public:
+    bool frameless = false;	// no epilogue to run
+
     ASMReturn() {}
 
     virtual void pretty_print(ostream& out)
@@ -500,18 +556,50 @@ public:
 	out << "Return()" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
-	com("Function epilogue");
-	asmc("ldsr %r15", "move rbp to rsp");
-	asmc("popr %r15", "retreive old rbp from stack");
-	asmc("popr2 %r15", "retreive old rbp from stack part2");
+	if (!frameless)
+	    emit_epilogue(out);
 	
-	asm("ret");
-	asm("ret2");
-	out << endl;
+	out.op("ret");
+	out.op("ret2");
+	out.blank();
+    }
+
+    void emit_epilogue(MachineCode& out)
+    {
+	com("Function epilogue");
+	out.op("ldsr", MOperand::reg(r15), "move rbp to rsp");
+	out.op("popr", MOperand::reg(r15), "retreive old rbp from stack");
+	out.op("popr2", MOperand::reg(r15), "retreive old rbp from stack part2");
+    }
+};
+
+// the epilogue of a return, then a jump to target, which returns to
+// our caller in our place. The args are already in our arg slots
+class ASMTailCall : public ASMReturn
+{
+public:
+    string target;
+
+    ASMTailCall(string _target) : target(_target) {}
+
+    virtual void pretty_print(ostream& out)
+    {
+	out << "TailCall(" + target + ")" << endl;
+    }
+
+    virtual void emit(MachineCode& out)
+    {
+	com_self();
+
+	if (!frameless)
+	    emit_epilogue(out);
+
+	out.op("jmp", MOperand::label_ref(target), "tail call, the return address is still ours");
+	out.blank();
     }
 };
 
@@ -534,10 +622,16 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void legalize(unordered_map<string, int>& temps, int& local_count)
+    virtual void legalize(FrameLayout& frame)
+    {
+        dest = dest->legalize_op(frame);
+	src = src->legalize_op(frame);
+    }
+
+    virtual void operands(vector<ASMOperand*>& reads, vector<ASMOperand*>& writes)
     {
-        dest = dest->legalize_op(temps, local_count);
-	src = src->legalize_op(temps, local_count);
+	reads.push_back(src);
+	writes.push_back(dest);
     }
 };
 
@@ -565,11 +659,18 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void legalize(unordered_map<string, int>& temps, int& local_count)
+    virtual void legalize(FrameLayout& frame)
+    {
+        dest = dest->legalize_op(frame);
+	src1 = src1->legalize_op(frame);
+	src2 = src2->legalize_op(frame);
+    }
+
+    virtual void operands(vector<ASMOperand*>& reads, vector<ASMOperand*>& writes)
     {
-        dest = dest->legalize_op(temps, local_count);
-	src1 = src1->legalize_op(temps, local_count);
-	src2 = src2->legalize_op(temps, local_count);
+	reads.push_back(src1);
+	reads.push_back(src2);
+	writes.push_back(dest);
     }
 };
 
@@ -591,18 +692,19 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 	
         emit_ldb_operand(src, out);
 
-	asmc("ldai 0xffff", "we subtract the number from -1 to get its bitwise inversion");
-	asm("sub");
+	out.op("ldai", MOperand::imm(0xffff), "we subtract the number from -1 to get its bitwise inversion");
+	out.op("sub");
 	
 	emit_sta_operand(dest, out);
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
 
@@ -623,18 +725,19 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
 	emit_ldb_operand(src, out);
 
-	asmc("ldai 0", "we subtract the number from 0 to get its negation");
-	asm("sub");
+	out.op("ldai", MOperand::imm(0), "we subtract the number from 0 to get its negation");
+	out.op("sub");
 
 	emit_sta_operand(dest, out);
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
 
@@ -656,18 +759,19 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
 	emit_lda_operand(src1, out);
 	emit_ldb_operand(src2, out);
 
-	asm("add");
+	out.op("add");
 
 	emit_sta_operand(dest, out);
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
     
 };
@@ -690,80 +794,79 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
 	emit_lda_operand(src1, out);
 	emit_ldb_operand(src2, out);
 
-	asm("sub");
+	out.op("sub");
 
 	emit_sta_operand(dest, out);
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
     
 };
 
-class ASMMul : public ASMBinary
+// multiply by a constant, inline as shifts and adds
+class ASMMulConst : public ASMUnary
 {
 public:
-    ASMMul(ASMOperand* _dest, ASMOperand* _src1, ASMOperand* _src2)
-    : ASMBinary(_dest, _src1, _src2)
+    int factor;
+
+    ASMMulConst(ASMOperand* _dest, ASMOperand* _src, int _factor)
+    : ASMUnary(_dest, _src),
+    factor(_factor)
     {}
 
     virtual void pretty_print(ostream& out)
     {
-	out << "Mul(";
+	out << "MulConst(";
 	dest->pretty_print(out);
 	out << ", ";
-	src1->pretty_print(out);
-	out << ", ";
-	src2->pretty_print(out);
-	out << ")" << endl;
+	src->pretty_print(out);
+	out << ", " << factor << ")" << endl;
     }
-    
-};
-
-class ASMDiv : public ASMBinary
-{
-public:
-    ASMDiv(ASMOperand* _dest, ASMOperand* _src1, ASMOperand* _src2)
-    : ASMBinary(_dest, _src1, _src2)
-    {}
 
-    virtual void pretty_print(ostream& out)
+    virtual void emit(MachineCode& out)
     {
-	out << "Div(";
-	dest->pretty_print(out);
-	out << ", ";
-	src1->pretty_print(out);
-	out << ", ";
-	src2->pretty_print(out);
-	out << ")" << endl;
-    }
-    
-};
+	com_self();
 
-class ASMMod : public ASMBinary
-{
-public:
-    ASMMod(ASMOperand* _dest, ASMOperand* _src1, ASMOperand* _src2)
-    : ASMBinary(_dest, _src1, _src2)
-    {}
+	if ((factor & 0xffff) == 0)
+	{
+	    out.op("ldai", MOperand::imm(0));
+	    emit_sta_operand(dest, out);
+	    out.blank();
+	    out.blank();
+	    return;
+	}
 
-    virtual void pretty_print(ostream& out)
-    {
-	out << "Mod(";
-	dest->pretty_print(out);
-	out << ", ";
-	src1->pretty_print(out);
-	out << ", ";
-	src2->pretty_print(out);
-	out << ")" << endl;
+	bool negate;
+	vector<string> sequence = multiply_sequence(factor, negate);
+
+	emit_lda_operand(src, out);
+	if (count(sequence.begin(), sequence.end(), "shl") != sequence.size())
+	    emit_ldb_operand(src, out);	// only the adds and subs need it
+
+	for (string op : sequence)
+	    out.op(op);
+
+	if (negate)
+	{
+	    out.op("ldra", MOperand::reg(r13), "negate");
+	    out.op("ldbr", MOperand::reg(r13));
+	    out.op("ldai", MOperand::imm(0));
+	    out.op("sub");
+	}
+
+	emit_sta_operand(dest, out);
+
+	out.blank();
+	out.blank();
     }
-    
 };
 
 class ASMBitAnd : public ASMBinary
@@ -784,18 +887,19 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
 	emit_lda_operand(src1, out);
 	emit_ldb_operand(src2, out);
 
-	asm("and");
+	out.op("and");
 
 	emit_sta_operand(dest, out);
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
     
     
@@ -816,13 +920,14 @@ public:
 	out << "Jump(" << jump_to << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
-	asm("jmp " + jump_to);
+	out.op("jmp", MOperand::label_ref(jump_to));
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
 
@@ -841,13 +946,14 @@ public:
 	out << "JumpZero(" << jump_to << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
-	asmc("jz " + jump_to, "jump if zero");
+	out.op("jz", MOperand::label_ref(jump_to), "jump if zero");
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
 
@@ -866,13 +972,14 @@ public:
 	out << "JumpLesser(" << jump_to << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
-	asmc("jl " + jump_to, "jump if lesser");
+	out.op("jl", MOperand::label_ref(jump_to), "jump if lesser");
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
 
@@ -891,13 +998,14 @@ public:
 	out << "JumpGreater(" << jump_to << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
-	asmc("jg " + jump_to, "jump if lesser");
+	out.op("jg", MOperand::label_ref(jump_to), "jump if lesser");
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
 
@@ -917,16 +1025,17 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
 	emit_lda_operand(src1, out);
 	emit_ldb_operand(src2, out);
 
-	asm("cmp");
+	out.op("cmp");
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
     
 };
@@ -946,12 +1055,13 @@ public:
 	out << "Label(" << name << ")" << endl;
     }
 
-    virtual void emit(ostream& out)
+    virtual void emit(MachineCode& out)
     {
 	com_self();
 
 	asml(name);
 
-	out << endl << endl;
+	out.blank();
+	out.blank();
     }
 };
@@ -0,0 +1,263 @@
+#include "assembler.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+using namespace std;
+
+OpcodeTable::OpcodeTable()
+{
+    opcodes = {
+	// confirmed against the asm_test images made by mas
+	{"lds"	, OpcodeInfo(0x09, IMM_OPERAND)},
+	{"cmp"	, OpcodeInfo(0x0e, NO_OPERAND)},
+	{"jg"	, OpcodeInfo(0x12, ADDR_OPERAND)},
+	{"jz"	, OpcodeInfo(0x14, ADDR_OPERAND)},
+	{"hlt"	, OpcodeInfo(0x15, NO_OPERAND)},
+	{"sub"	, OpcodeInfo(0x18, NO_OPERAND)},
+	{"add"	, OpcodeInfo(0x19, NO_OPERAND)},
+	{"and"	, OpcodeInfo(0x1a, NO_OPERAND)},
+	{"ldbi"	, OpcodeInfo(0x1c, IMM_OPERAND)},
+	{"ldai"	, OpcodeInfo(0x1d, IMM_OPERAND)},
+	{"jmp"	, OpcodeInfo(0x1e, ADDR_OPERAND)},
+	{"ldrs"	, OpcodeInfo(0x30, REG_OPERAND)},
+	{"ldmaa", OpcodeInfo(0x31, NO_OPERAND)},
+	{"ldsa"	, OpcodeInfo(0x32, NO_OPERAND)},
+	{"ldas"	, OpcodeInfo(0x33, NO_OPERAND)},
+	{"ldmra", OpcodeInfo(0x34, REG_OPERAND)},
+	{"ldbr"	, OpcodeInfo(0x38, REG_OPERAND)},
+	{"ldar"	, OpcodeInfo(0x39, REG_OPERAND)},
+	{"ldrb"	, OpcodeInfo(0x3b, REG_OPERAND)},
+	{"ldra"	, OpcodeInfo(0x3c, REG_OPERAND)},
+    };
+}
+
+// splits on whitespace and commas
+vector<string> split_words(string line)
+{
+    vector<string> result;
+    string word;
+    for (char c : line) {
+	if (isspace((unsigned char)c) || c == ',') {
+	    if (!word.empty())
+		result.push_back(word);
+	    word.clear();
+	} else {
+	    word += c;
+	}
+    }
+    if (!word.empty())
+	result.push_back(word);
+    return result;
+}
+
+// decimal, 0x and 0b numbers, negatives are stored as two's complement
+bool parse_number(string text, int& value)
+{
+    bool negative = text.size() > 1 && text[0] == '-';
+    if (negative)
+	text = text.substr(1);
+
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'b')) {
+	base = text[1] == 'x' ? 16 : 2;
+	text = text.substr(2);
+    }
+
+    if (text.empty() || !isalnum((unsigned char)text[0]))
+	return false;
+
+    char* end;
+    long result = strtol(text.c_str(), &end, base);
+    if (*end != '\0' || result > 0xffff)
+	return false;
+
+    value = negative ? -result : result;
+    return value >= -0x8000;
+}
+
+bool parse_register(string text, int& reg)
+{
+    if (text.size() < 3 || text.substr(0, 2) != "%r")
+	return false;
+
+    string number = text.substr(2);
+    for (char c : number) {
+	if (!isdigit((unsigned char)c))
+	    return false;
+    }
+
+    reg = stoi(number);
+    return reg < 16;
+}
+
+OperandKind parse_operand_kind(string text, bool& ok)
+{
+    ok = true;
+    if (text == "-") return NO_OPERAND;
+    if (text == "r") return REG_OPERAND;
+    if (text == "i") return IMM_OPERAND;
+    if (text == "a") return ADDR_OPERAND;
+    if (text == "ri") return REG_IMM_OPERAND;
+    ok = false;
+    return NO_OPERAND;
+}
+
+void OpcodeTable::load(string text)
+{
+    stringstream lines(text);
+    int line_number = 0;
+    for (string line; getline(lines, line);) {
+	line_number++;
+	line = line.substr(0, line.find('#'));
+	vector<string> words = split_words(line);
+	if (words.empty())
+	    continue;
+
+	int opcode;
+	bool ok = words.size() == 3 && parse_number(words[1], opcode) && opcode >= 0 && opcode <= 0xff;
+	OperandKind operands = ok ? parse_operand_kind(words[2], ok) : NO_OPERAND;
+	if (!ok)
+	    throw CompileError("opcode table: expected 'mnemonic opcode operands'", line_number, 0, line.length());
+
+	opcodes[words[0]] = OpcodeInfo(opcode, operands);
+    }
+}
+
+// an operand as written, registers and numbers first, anything else is a label
+MOperand parse_operand(string text)
+{
+    int value;
+    if (parse_register(text, value))
+	return MOperand::reg(value);
+    if (parse_number(text, value))
+	return MOperand::imm(value);
+    return MOperand::label_ref(text);
+}
+
+MachineCode parse_machine_code(string text)
+{
+    MachineCode code;
+    stringstream lines(text);
+    int line_number = 0;
+    for (string line; getline(lines, line);) {
+	line_number++;
+	size_t comment_start = line.find(';');
+	vector<string> words = split_words(line.substr(0, comment_start));
+
+	vector<MInstr> parsed;
+	while (!words.empty() && words[0].back() == ':') {
+	    parsed.push_back(MInstr(MI_LABEL, words[0].substr(0, words[0].size() - 1)));
+	    words.erase(words.begin());
+	}
+
+	if (!words.empty())
+	{
+	    MInstr inst(MI_INSTR, words[0]);
+	    for (int i = 1; i < words.size(); i++)
+		inst.operands.push_back(parse_operand(words[i]));
+	    if (comment_start != string::npos)
+		inst.comment = line.substr(comment_start + 1);
+	    parsed.push_back(inst);
+	}
+
+	for (MInstr& inst : parsed) {
+	    code.instrs.push_back(inst);
+	    code.instrs.back().line_number = line_number;
+	    code.instrs.back().length = line.length();
+	}
+    }
+    return code;
+}
+
+void asm_fail(const MInstr& inst, string message)
+{
+    throw CompileError("Assembler: " + message, inst.line_number, 0, inst.length);
+}
+
+int words_of(OperandKind kind)
+{
+    return kind == NO_OPERAND || kind == REG_OPERAND ? 1 : 2;
+}
+
+ObjectFile assemble_object(const MachineCode& code, OpcodeTable& table, set<string> globals, bool allow_undefined)
+{
+    ObjectFile obj;
+    vector<pair<const MInstr*, OpcodeInfo>> program;
+    int address = 0;
+
+    // first pass, find the offset of every label
+    for (const MInstr& inst : code.instrs) {
+	if (inst.kind == MI_LABEL)
+	{
+	    if (!obj.define(inst.name, address, globals.count(inst.name)))
+		asm_fail(inst, "label " + inst.name + " defined twice");
+	    continue;
+	}
+
+	if (!inst.is_instruction())
+	    continue;
+
+	auto it = table.opcodes.find(inst.name);
+	if (it == table.opcodes.end())
+	    asm_fail(inst, "no encoding known for '" + inst.name + "', it can be given with --opcodes");
+
+	program.push_back({&inst, it->second});
+
+	address += words_of(it->second.operands);
+	if (address > 0x10000 - IMAGE_ORIGIN)
+	    asm_fail(inst, "program does not fit in memory");
+    }
+
+    // second pass, encode
+    for (auto& entry : program) {
+	const MInstr& inst = *entry.first;
+	OperandKind kind = entry.second.operands;
+	int expected = kind == NO_OPERAND ? 0 : kind == REG_IMM_OPERAND ? 2 : 1;
+	if (inst.operands.size() != expected)
+	    asm_fail(inst, inst.name + " takes " + to_string(expected) + " operands");
+
+	int reg = 0;
+	if (kind == REG_OPERAND || kind == REG_IMM_OPERAND)
+	{
+	    const MOperand& operand = inst.operands[0];
+	    if (operand.kind != MOP_REG || operand.value < 0 || operand.value > 15)
+		asm_fail(inst, "expected a register instead of " + operand.to_string());
+	    reg = operand.value;
+	}
+
+	obj.code.push_back(entry.second.opcode << 8 | reg);
+
+	if (kind == IMM_OPERAND || kind == REG_IMM_OPERAND) {
+	    const MOperand& operand = inst.operands.back();
+	    if (operand.kind != MOP_IMM || operand.value < -0x8000 || operand.value > 0xffff)
+		asm_fail(inst, "expected a 16 bit number instead of " + operand.to_string());
+	    obj.code.push_back(operand.value);
+	}
+	else if (kind == ADDR_OPERAND) {
+	    const MOperand& operand = inst.operands[0];
+	    if (operand.kind == MOP_IMM) {
+		obj.code.push_back(operand.value);
+		continue;
+	    }
+	    if (operand.kind != MOP_LABEL)
+		asm_fail(inst, "expected an address instead of " + operand.to_string());
+
+	    int sym = obj.symbol(operand.label);
+	    if (!obj.symbols[sym].defined && !allow_undefined)
+		asm_fail(inst, "undefined label " + operand.label);
+
+	    obj.relocations.push_back(Relocation(obj.code.size(), sym));
+	    obj.code.push_back(0);
+	}
+    }
+
+    return obj;
+}
+
+vector<unsigned char> assemble(string text, OpcodeTable& table)
+{
+    vector<ObjectFile> objects = {assemble_object(parse_machine_code(text), table, {}, false)};
+    return link(objects);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "mcc.hpp"
+#include "object.hpp"
+#include "machine.hpp"
+
+using namespace std;
+
+// Assembles machine code, or the text mcc emits, into a Mentat memory
+// image.
+//
+// Every instruction is one big endian word, the opcode in the high byte
+// and the register operand (if any) in the low byte. Immediates and
+// addresses take a second word. Code is placed from 0x8000, which is
+// where the labels resolve to.
+
+#define IMAGE_ORIGIN 0x8000
+
+enum OperandKind
+{
+    NO_OPERAND,			// add
+    REG_OPERAND,		// ldar %r3
+    IMM_OPERAND,		// ldai 5
+    ADDR_OPERAND,		// jmp label
+    REG_IMM_OPERAND		// ldri %r2 10
+};
+
+class OpcodeInfo
+{
+public:
+    int opcode;
+    OperandKind operands;
+
+    OpcodeInfo(int _opcode = 0, OperandKind _operands = NO_OPERAND)
+	:
+	opcode(_opcode),
+	operands(_operands)
+    {}
+};
+
+// mnemonic -> encoding. Starts out with only the instructions whose
+// encodings were checked against images made by mas, the others (calls,
+// pushes, output and so on) have to be given with a table with lines like
+//     pushr 0x20 r
+// where the operands are one of - r i a ri
+class OpcodeTable
+{
+public:
+    map<string, OpcodeInfo> opcodes;
+
+    OpcodeTable();
+
+    void load(string text);
+};
+
+// assembly text as machine code records, the operands are typed but not
+// checked against the opcodes yet. Records keep their line number.
+MachineCode parse_machine_code(string text);
+
+// labels named in globals are visible to other objects, references to
+// labels not defined in code become relocations against undefined
+// symbols when allow_undefined is set. Throws CompileError with the line
+// number of the offending record.
+ObjectFile assemble_object(const MachineCode& code, OpcodeTable& table, set<string> globals, bool allow_undefined);
+
+// assembles a whole program written in assembly into its memory image
+vector<unsigned char> assemble(string text, OpcodeTable& table);
@@ -0,0 +1,545 @@
+// mcc_bench - compiler throughput benchmark
+//
+// Generates synthetic .mc programs that grow along one axis at a time
+// (function count, statement count, nesting depth, expression length
+// and identifier count), times every phase of the mcc pipeline on them
+// and fits a scaling exponent for each phase. The results are checked
+// against a stored baseline so complexity or throughput regressions
+// fail the run. So does a phase the baseline has no entry for, a commit
+// that adds a phase has to add it to the baseline as well.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "../CLI11.hpp"
+
+using namespace std;
+
+// the size knobs of a generated program
+class ProgramShape
+{
+public:
+    int functions;
+    int statements;		// top level statements per function
+    int depth;			// how deep control flow is nested
+    int expression_length;	// operands per expression
+    int identifiers;		// local variables per function
+
+    ProgramShape(int _functions=2,
+		 int _statements=20,
+		 int _depth=2,
+		 int _expression_length=4,
+		 int _identifiers=8)
+    :
+	functions(_functions),
+	statements(_statements),
+	depth(_depth),
+	expression_length(_expression_length),
+	identifiers(_identifiers)
+    {}
+
+    int& knob(string axis)
+    {
+	if (axis == "functions")
+	    return functions;
+	else if (axis == "statements")
+	    return statements;
+	else if (axis == "depth")
+	    return depth;
+	else if (axis == "expression")
+	    return expression_length;
+
+	return identifiers;
+    }
+};
+
+// writes a deterministic, valid mcc program of the requested shape
+class ProgramGenerator
+{
+public:
+    ProgramShape shape;
+    unsigned int seed;
+    int loop_count;
+    stringstream out;
+
+    ProgramGenerator(ProgramShape _shape, unsigned int _seed=1)
+    :
+	shape(_shape),
+	seed(_seed),
+	loop_count(0)
+    {}
+
+    // small LCG so that the same shape always gives the same program
+    int rand_int(int limit)
+    {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % limit;
+    }
+
+    string indent(int level)
+    {
+	return string(level, '\t');
+    }
+
+    string variable()
+    {
+	return "v" + to_string(rand_int(shape.identifiers));
+    }
+
+    string operand(int func)
+    {
+	int choice = rand_int(4);
+	if (choice == 0)
+	    return to_string(rand_int(16));
+	else if (choice == 1 && func < shape.functions - 1) // main has no params
+	    return "p" + to_string(rand_int(2));
+
+	return variable();
+    }
+
+    string expression(int func)
+    {
+	string result = operand(func);
+	for (int i=1;i<shape.expression_length;i++)
+	{
+	    result += (rand_int(2) ? " + " : " - ") + operand(func);
+	}
+	return result;
+    }
+
+    string condition(int func)
+    {
+	// "!=" is left out, the tokenizer splits it into "!" and "="
+	static const char* compare_ops[] = { "<", ">", "<=", ">=", "==" };
+	string result = variable() + " " + compare_ops[rand_int(5)] + " " + operand(func);
+
+	if (rand_int(3) == 0)
+	    result += (rand_int(2) ? " && " : " || ") + variable() + " > " + to_string(rand_int(8));
+
+	return result;
+    }
+
+    void simple_statement(int func, int level)
+    {
+	int choice = rand_int(6);
+
+	if (choice == 0 && func > 0) // functions may only call the ones defined before them
+	{
+	    out << indent(level) << variable() << " = f" << rand_int(func) << "("
+		<< expression(func) << ", " << operand(func) << ");" << endl;
+	}
+	else if (choice == 1)
+	{
+	    out << indent(level) << variable() << "++;" << endl;
+	}
+	else if (choice == 2)
+	{
+	    out << indent(level) << variable() << " = " << variable() << " < " << operand(func)
+		<< " ? " << expression(func) << " : " << operand(func) << ";" << endl;
+	}
+	else
+	{
+	    out << indent(level) << variable() << " = " << expression(func) << ";" << endl;
+	}
+    }
+
+    void nested_statement(int func, int level, int depth)
+    {
+	string counter = "i" + to_string(loop_count++);
+
+	switch (rand_int(4))
+	{
+	case 0:
+	    out << indent(level) << "if (" << condition(func) << ")" << endl;
+	    block(func, level, depth + 1, 2);
+	    out << indent(level) << "else" << endl;
+	    block(func, level, shape.depth, 1); // only one branch nests further, keeping growth linear
+	    break;
+	case 1:
+	    out << indent(level) << "for (int " << counter << " = 0; " << counter << " < 3; "
+		<< counter << "++)" << endl;
+	    block(func, level, depth + 1, 2);
+	    break;
+	case 2:
+	    out << indent(level) << "int " << counter << " = 0;" << endl;
+	    out << indent(level) << "while (" << counter << " < 3)" << endl;
+	    out << indent(level) << "{" << endl;
+	    statements(func, level + 1, depth + 1, 2);
+	    out << indent(level + 1) << counter << " = " << counter << " + 1;" << endl;
+	    out << indent(level) << "}" << endl;
+	    break;
+	default:
+	    out << indent(level) << "int " << counter << " = 0;" << endl;
+	    out << indent(level) << "do" << endl;
+	    out << indent(level) << "{" << endl;
+	    statements(func, level + 1, depth + 1, 2);
+	    out << indent(level + 1) << counter << " = " << counter << " + 1;" << endl;
+	    out << indent(level) << "} while (" << counter << " < 3);" << endl;
+	    break;
+	}
+    }
+
+    void statements(int func, int level, int depth, int count)
+    {
+	for (int i=0;i<count;i++)
+	{
+	    // every fourth statement opens a nested chain that reaches the requested depth
+	    if (i % 4 == 0 && depth < shape.depth)
+		nested_statement(func, level, depth);
+	    else
+		simple_statement(func, level);
+	}
+    }
+
+    void block(int func, int level, int depth, int count)
+    {
+	out << indent(level) << "{" << endl;
+	statements(func, level + 1, depth, count);
+	out << indent(level) << "}" << endl;
+    }
+
+    void function(int func)
+    {
+	bool is_main = (func == shape.functions - 1);
+
+	if (is_main)
+	    out << "int main()" << endl;
+	else
+	    out << "int f" << func << "(int p0, int p1)" << endl;
+
+	out << "{" << endl;
+
+	for (int i=0;i<shape.identifiers;i++) {
+	    out << "\tint v" << i << " = " << (is_main ? to_string(i) : "p" + to_string(i % 2)) << ";" << endl;
+	}
+
+	statements(func, 1, 0, shape.statements);
+
+	out << "\treturn " << expression(func) << ";" << endl;
+	out << "}" << endl << endl;
+    }
+
+    string generate()
+    {
+	for (int i=0;i<shape.functions;i++) {
+	    function(i);
+	}
+	return out.str();
+    }
+};
+
+// timing of every phase for one generated program
+class Measurement
+{
+public:
+    int knob;
+    size_t bytes;
+    map<string, double> phase_ms;
+};
+
+// fitted behaviour of one phase along one axis
+class Trend
+{
+public:
+    double exponent;
+    double throughput;		// KiB of source per second at the largest size
+
+    Trend(double _exponent=0, double _throughput=0)
+    :
+	exponent(_exponent),
+	throughput(_throughput)
+    {}
+};
+
+string mcc_path = "./mcc";
+string baseline_path = "bench/baseline.txt";
+string dump_dir = "";
+int repeat = 3;
+int points = 4;
+double exponent_slack = 0.35;
+double throughput_slack = 0.5;
+double min_measurable_ms = 0.5;	// phases faster than this are too noisy to fit
+bool update_baseline = false;
+
+vector<string> phase_order;
+
+// runs mcc on the program and returns the per phase times it reports
+map<string, double> run_mcc(string source_file, string output_file)
+{
+    string command = mcc_path + " --time-passes -i " + source_file + " -o " + output_file + " 2>&1";
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe)
+    {
+	cerr << "could not run " << command << endl;
+	exit(2);
+    }
+
+    map<string, double> result;
+    string output;
+    char line[512];
+    while (fgets(line, sizeof(line), pipe))
+    {
+	output += line;
+
+	stringstream ss(line);
+	string word, phase;
+	double ms;
+	if ((ss >> word >> phase >> ms) && word == "phase")
+	{
+	    if (find(phase_order.begin(), phase_order.end(), phase) == phase_order.end())
+		phase_order.push_back(phase);
+	    result[phase] = ms;
+	}
+    }
+
+    if (pclose(pipe) != 0 || result.empty())
+    {
+	cerr << "mcc failed on " << source_file << ":" << endl << output << endl;
+	exit(2);
+    }
+    return result;
+}
+
+Measurement measure(ProgramShape shape, string axis)
+{
+    string source = ProgramGenerator(shape).generate();
+
+    char source_file[] = "/tmp/mcc_bench_XXXXXX";
+    int fd = mkstemp(source_file);
+    close(fd);
+    ofstream(source_file, ios::trunc) << source;
+    string output_file = string(source_file) + ".s";
+
+    if (dump_dir != "")
+	ofstream(dump_dir + "/" + axis + "_" + to_string(shape.knob(axis)) + ".mc", ios::trunc) << source;
+
+    Measurement m;
+    m.knob = shape.knob(axis);
+    m.bytes = source.size();
+
+    // the minimum of several runs is the least noisy estimate
+    for (int i=0;i<repeat;i++)
+    {
+	map<string, double> times = run_mcc(source_file, output_file);
+	for (auto& t : times)
+	{
+	    if (i == 0 || t.second < m.phase_ms[t.first])
+		m.phase_ms[t.first] = t.second;
+	}
+    }
+
+    remove(source_file);
+    remove(output_file.c_str());
+    return m;
+}
+
+// least squares slope of log(time) against log(knob), 1.0 means linear in the knob
+double fit_exponent(vector<Measurement>& curve, string phase)
+{
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = curve.size();
+    for (Measurement& m : curve)
+    {
+	double x = log((double)m.knob);
+	double y = log(max(m.phase_ms[phase], 1e-6));
+	sx += x;
+	sy += y;
+	sxx += x * x;
+	sxy += x * y;
+    }
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+void print_curve(string axis, vector<Measurement>& curve, map<string, Trend>& trends)
+{
+    cout << "== axis: " << axis << endl;
+    cout << left << setw(8) << "knob" << setw(10) << "bytes";
+    for (string phase : phase_order) {
+	cout << right << setw(13) << phase;
+    }
+    cout << endl;
+
+    cout << fixed << setprecision(3);
+    for (Measurement& m : curve)
+    {
+	cout << left << setw(8) << m.knob << setw(10) << m.bytes;
+	for (string phase : phase_order) {
+	    cout << right << setw(13) << m.phase_ms[phase];
+	}
+	cout << endl;
+    }
+
+    cout << left << setw(18) << "exponent";
+    for (string phase : phase_order)
+    {
+	if (trends.count(phase))
+	    cout << right << setw(13) << setprecision(2) << trends[phase].exponent;
+	else
+	    cout << right << setw(13) << "-";
+    }
+    cout << endl;
+
+    cout << left << setw(18) << "KiB/s";
+    for (string phase : phase_order)
+    {
+	if (trends.count(phase))
+	    cout << right << setw(13) << setprecision(0) << trends[phase].throughput;
+	else
+	    cout << right << setw(13) << "-";
+    }
+    cout << endl << endl;
+}
+
+map<string, Trend> read_baseline(string filename)
+{
+    map<string, Trend> result;
+    ifstream in(filename);
+    string line;
+    while (getline(in, line))
+    {
+	if (line.empty() || line[0] == '#')
+	    continue;
+
+	stringstream ss(line);
+	string axis, phase;
+	double exponent, throughput;
+	if (ss >> axis >> phase >> exponent >> throughput)
+	    result[axis + " " + phase] = Trend(exponent, throughput);
+    }
+    return result;
+}
+
+void write_baseline(string filename, map<string, Trend>& trends)
+{
+    ofstream out(filename, ios::trunc);
+    out << "# mcc_bench baseline, regenerate with: make bench BENCH_FLAGS=--update-baseline" << endl;
+    out << "# axis phase exponent throughput(KiB/s)" << endl;
+    out << fixed;
+    for (auto& t : trends) {
+	out << t.first << " " << setprecision(3) << t.second.exponent
+	    << " " << setprecision(1) << t.second.throughput << endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    CLI::App app{"mcc_bench - scaling benchmark for the mcc compiler phases"};
+    app.add_option("--mcc", mcc_path, "The mcc binary to benchmark");
+    app.add_option("--baseline", baseline_path, "The stored baseline to compare against");
+    app.add_option("--repeat", repeat, "Runs per program, the fastest is kept");
+    app.add_option("--points", points, "Number of sizes along each axis");
+    app.add_option("--exponent-slack", exponent_slack, "Allowed growth of a scaling exponent");
+    app.add_option("--throughput-slack", throughput_slack, "Minimum fraction of the baseline throughput");
+    app.add_option("--dump", dump_dir, "Also write the generated programs to this directory");
+    app.add_flag("--update-baseline", update_baseline, "Overwrite the baseline with this run");
+    CLI11_PARSE(app, argc, argv);
+
+    vector<string> axes = { "functions", "statements", "depth", "expression", "identifiers" };
+
+    map<string, Trend> results;
+    for (string axis : axes)
+    {
+	ProgramShape shape;
+	vector<Measurement> curve;
+
+	// each axis doubles its knob while the others stay at the base shape
+	for (int i=0;i<points;i++)
+	{
+	    curve.push_back(measure(shape, axis));
+	    shape.knob(axis) *= 2;
+	}
+
+	map<string, Trend> trends;
+	for (string phase : phase_order)
+	{
+	    Measurement& largest = curve.back();
+	    if (largest.phase_ms[phase] < min_measurable_ms)
+		continue;
+
+	    double kib = largest.bytes / 1024.0;
+	    trends[phase] = Trend(fit_exponent(curve, phase), kib / (largest.phase_ms[phase] / 1000.0));
+	    results[axis + " " + phase] = trends[phase];
+	}
+
+	print_curve(axis, curve, trends);
+    }
+
+    if (update_baseline)
+    {
+	write_baseline(baseline_path, results);
+	cout << "baseline written to " << baseline_path << endl;
+	return 0;
+    }
+
+    map<string, Trend> baseline = read_baseline(baseline_path);
+    if (baseline.empty())
+    {
+	cout << "no baseline at " << baseline_path << ", run with --update-baseline to create one" << endl;
+	return 0;
+    }
+
+    // the phases the baseline knows about on any axis
+    set<string> known_phases;
+    for (auto& b : baseline)
+	known_phases.insert(b.first.substr(b.first.find(' ') + 1));
+
+    int regressions = 0;
+    for (auto& r : results)
+    {
+	if (baseline.count(r.first) == 0)
+	{
+	    // a phase the baseline has never seen was added without extending
+	    // it, one that is known elsewhere only just became measurable here
+	    string phase = r.first.substr(r.first.find(' ') + 1);
+	    if (known_phases.count(phase) == 0)
+	    {
+		cout << "MISSING " << r.first << ": not in " << baseline_path
+		     << ", rerun with --update-baseline and commit it with the new phase" << endl;
+		regressions++;
+	    }
+	    else
+		cout << "WARNING " << r.first << ": not in " << baseline_path << ", not checked" << endl;
+	    continue;
+	}
+
+	Trend& base = baseline[r.first];
+	if (r.second.exponent > base.exponent + exponent_slack)
+	{
+	    cout << "REGRESSION " << r.first << ": scaling exponent " << setprecision(2) << r.second.exponent
+		 << " (baseline " << base.exponent << ")" << endl;
+	    regressions++;
+	}
+	if (r.second.throughput < base.throughput * throughput_slack)
+	{
+	    cout << "REGRESSION " << r.first << ": throughput " << setprecision(0) << r.second.throughput
+		 << " KiB/s (baseline " << base.throughput << " KiB/s)" << endl;
+	    regressions++;
+	}
+    }
+
+    for (auto& b : baseline)
+    {
+	if (results.count(b.first) == 0)
+	    cout << "WARNING " << b.first << ": in " << baseline_path << " but not measured, not checked" << endl;
+    }
+
+    if (regressions)
+    {
+	cout << regressions << " regression(s) against " << baseline_path << endl;
+	return 1;
+    }
+
+    cout << "no regressions against " << baseline_path << endl;
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+CFG::CFG(IRCode& code)
+{
+    int n = code.insts.size();
+    block_of.resize(n);
+
+    map<int, int> label_block;
+    for (int i = 0; i < n; i++) {
+	IRInst& inst = code.insts[i];
+	bool leader = i == 0 || inst.op == IR_LABEL
+	    || is_branch(code.insts[i - 1].op) || code.insts[i - 1].op == IR_RETURN;
+	if (leader)
+	{
+	    blocks.push_back(CFGBlock());
+	    blocks.back().start = i;
+	}
+	blocks.back().end = i;
+	block_of[i] = blocks.size() - 1;
+
+	if (inst.op == IR_LABEL)
+	    label_block[inst.dest.id] = blocks.size() - 1;
+    }
+
+    for (int b = 0; b < blocks.size(); b++) {
+	IRInst& last = code.insts[blocks[b].end];
+	if (is_branch(last.op))
+	    blocks[b].succs.push_back(label_block[branch_target(last).id]);
+	if (last.op != IR_JUMP && last.op != IR_RETURN && b + 1 < blocks.size())
+	{
+	    // a branch to the next block is still one edge
+	    if (blocks[b].succs.empty() || blocks[b].succs[0] != b + 1)
+		blocks[b].succs.push_back(b + 1);
+	}
+    }
+
+    for (int b = 0; b < blocks.size(); b++) {
+	for (int succ : blocks[b].succs)
+	    blocks[succ].preds.push_back(b);
+    }
+}
+
+vector<int> CFG::reverse_postorder()
+{
+    vector<int> order;
+    if (blocks.empty())
+	return order;
+
+    // iterative depth first search, next[b] is the next successor to visit
+    vector<bool> visited(blocks.size(), false);
+    vector<int> next(blocks.size(), 0);
+    vector<int> stack = {0};
+    visited[0] = true;
+
+    while (!stack.empty()) {
+	int b = stack.back();
+	if (next[b] < blocks[b].succs.size())
+	{
+	    int succ = blocks[b].succs[next[b]++];
+	    if (!visited[succ])
+	    {
+		visited[succ] = true;
+		stack.push_back(succ);
+	    }
+	    continue;
+	}
+	order.push_back(b);
+	stack.pop_back();
+    }
+
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+DominatorTree::DominatorTree(CFG& cfg)
+{
+    int n = cfg.blocks.size();
+    idom.assign(n, -1);
+    children.resize(n);
+    frontier.resize(n);
+    rpo = cfg.reverse_postorder();
+    if (n == 0)
+	return;
+
+    vector<int> rpo_index(n, -1);
+    for (int i = 0; i < rpo.size(); i++)
+	rpo_index[rpo[i]] = i;
+
+    // the entry is its own idom while solving, so that intersect stops there
+    idom[0] = 0;
+    auto intersect = [&](int a, int b) {
+	while (a != b) {
+	    while (rpo_index[a] > rpo_index[b])
+		a = idom[a];
+	    while (rpo_index[b] > rpo_index[a])
+		b = idom[b];
+	}
+	return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+	changed = false;
+	for (int b : rpo) {
+	    if (b == 0)
+		continue;
+
+	    int new_idom = -1;
+	    for (int p : cfg.blocks[b].preds) {
+		if (idom[p] == -1)
+		    continue;
+		new_idom = new_idom == -1 ? p : intersect(p, new_idom);
+	    }
+	    if (new_idom != idom[b])
+	    {
+		idom[b] = new_idom;
+		changed = true;
+	    }
+	}
+    }
+
+    for (int b : rpo) {
+	if (b == 0)
+	    continue;
+	children[idom[b]].push_back(b);
+
+	// b is in the frontier of every block on the way up from a pred to idom(b)
+	if (cfg.blocks[b].preds.size() < 2)
+	    continue;
+	for (int p : cfg.blocks[b].preds) {
+	    if (rpo_index[p] == -1)
+		continue;
+	    for (int runner = p; runner != idom[b]; runner = idom[runner]) {
+		if (find(frontier[runner].begin(), frontier[runner].end(), b) == frontier[runner].end())
+		    frontier[runner].push_back(b);
+	    }
+	}
+    }
+
+    // the entry also joins the way in with any loop back to it
+    for (int p : cfg.blocks[0].preds) {
+	if (rpo_index[p] == -1)
+	    continue;
+	for (int runner = p; runner != 0; runner = idom[runner]) {
+	    if (find(frontier[runner].begin(), frontier[runner].end(), 0) == frontier[runner].end())
+		frontier[runner].push_back(0);
+	}
+	if (find(frontier[0].begin(), frontier[0].end(), 0) == frontier[0].end())
+	    frontier[0].push_back(0);
+    }
+    idom[0] = -1;
+}
+
+bool DominatorTree::dominates(int a, int b)
+{
+    while (b != -1 && b != a)
+	b = idom[b];
+    return b == a;
+}
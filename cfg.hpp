@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Basic blocks of the TACKY of one function, and the bit vectors the
+// dataflow analyses on them work with.
+
+class BitVector
+{
+public:
+    int size;
+    vector<unsigned long long> words;
+
+    BitVector(int _size = 0, bool value = false)
+	:
+	size(_size),
+	words((_size + 63) / 64, value ? ~0ULL : 0)
+    {
+	clear_padding();
+    }
+
+    bool test(int i) const
+    {
+	return (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    void set(int i)
+    {
+	words[i / 64] |= 1ULL << (i % 64);
+    }
+
+    void reset(int i)
+    {
+	words[i / 64] &= ~(1ULL << (i % 64));
+    }
+
+    void set_all()
+    {
+	for (unsigned long long& w : words)
+	    w = ~0ULL;
+	clear_padding();
+    }
+
+    // this = this | other
+    void unite(const BitVector& other)
+    {
+	for (int w = 0; w < words.size(); w++)
+	    words[w] |= other.words[w];
+    }
+
+    // this = this & other
+    void intersect(const BitVector& other)
+    {
+	for (int w = 0; w < words.size(); w++)
+	    words[w] &= other.words[w];
+    }
+
+    // this = this & ~other
+    void subtract(const BitVector& other)
+    {
+	for (int w = 0; w < words.size(); w++)
+	    words[w] &= ~other.words[w];
+    }
+
+    bool operator==(const BitVector& other) const { return words == other.words; }
+    bool operator!=(const BitVector& other) const { return words != other.words; }
+
+private:
+    // the bits past size stay 0, so that whole words compare equal
+    void clear_padding()
+    {
+	if (size % 64)
+	    words.back() &= (1ULL << (size % 64)) - 1;
+    }
+};
+
+// a straight run of instructions, [start, end] are positions in the code
+class CFGBlock
+{
+public:
+    int start;
+    int end;
+    vector<int> preds;
+    vector<int> succs;
+};
+
+class CFG
+{
+public:
+    vector<CFGBlock> blocks;	// blocks[0] is the entry
+    vector<int> block_of;	// the block of every instruction
+
+    // splits the code at labels and after branches and returns, the code
+    // must not contain IR_NOPs
+    CFG(IRCode& code);
+
+    // the blocks reachable from the entry, every block before its
+    // successors except along back edges
+    vector<int> reverse_postorder();
+};
+
+// immediate dominators and dominance frontiers of the blocks reachable
+// from the entry, computed as in Cooper, Harvey and Kennedy
+class DominatorTree
+{
+public:
+    vector<int> idom;		// -1 for the entry and unreachable blocks
+    vector<vector<int>> children;
+    vector<vector<int>> frontier;
+    vector<int> rpo;		// the reachable blocks in reverse postorder
+
+    DominatorTree(CFG& cfg);
+
+    bool reachable(int b) { return b == 0 || idom[b] != -1; }
+
+    // true if every path from the entry to b goes through a
+    bool dominates(int a, int b);
+};
@@ -0,0 +1,298 @@
+#include "combine.hpp"
+
+#include <map>
+
+using namespace std;
+
+static bool is_compare(IROpcode op)
+{
+    return op >= IR_EQUAL && op <= IR_GREATER;
+}
+
+// the compare that gives the opposite answer
+static IROpcode inverse(IROpcode op)
+{
+    switch (op)
+    {
+    case IR_EQUAL:		return IR_UNEQUAL;
+    case IR_UNEQUAL:		return IR_EQUAL;
+    case IR_GREATER_EQUAL:	return IR_LESS;
+    case IR_LESS_EQUAL:		return IR_GREATER;
+    case IR_LESS:		return IR_GREATER_EQUAL;
+    case IR_GREATER:		return IR_LESS_EQUAL;
+    default:			return op;
+    }
+}
+
+// the compare that gives the same answer with the operands swapped
+static IROpcode swapped(IROpcode op)
+{
+    switch (op)
+    {
+    case IR_GREATER_EQUAL:	return IR_LESS_EQUAL;
+    case IR_LESS_EQUAL:		return IR_GREATER_EQUAL;
+    case IR_LESS:		return IR_GREATER;
+    case IR_GREATER:		return IR_LESS;
+    default:			return op;
+    }
+}
+
+bool fold_constant(IROpcode op, int x, int y, int& result)
+{
+    short a = x, b = y;
+    switch (op)
+    {
+    case IR_LOAD:		result = a; break;
+    case IR_NEG:		result = -a; break;
+    case IR_NOT:		result = ~a; break;
+    case IR_ADD:		result = a + b; break;
+    case IR_SUB:		result = a - b; break;
+    case IR_MUL:		result = a * b; break;
+    case IR_DIV:
+	if (b == 0)
+	    return false;
+	result = a / b;
+	break;
+    case IR_MOD:
+	if (b == 0)
+	    return false;
+	result = a % b;
+	break;
+    case IR_BITAND:		result = a & b; break;
+    case IR_EQUAL:		result = a == b; break;
+    case IR_UNEQUAL:		result = a != b; break;
+    case IR_GREATER_EQUAL:	result = a >= b; break;
+    case IR_LESS_EQUAL:		result = a <= b; break;
+    case IR_LESS:		result = a < b; break;
+    case IR_GREATER:		result = a > b; break;
+    default:
+	return false;
+    }
+
+    result = (short)result;
+    return true;
+}
+
+// the instruction that last wrote v before position i, in the same block
+static int local_def(IRCode& code, int i, IRValue v)
+{
+    for (int j = i - 1; j >= 0; j--) {
+	IRInst& inst = code.insts[j];
+	if (inst.op == IR_LABEL)
+	    break;
+	if (defined_vreg(inst) == v.id)
+	    return j;
+    }
+    return -1;
+}
+
+// true if nothing in (from, to) writes v
+static bool unchanged_between(IRCode& code, int from, int to, IRValue v)
+{
+    if (!v.is_vreg())
+	return true;
+
+    for (int j = from + 1; j < to; j++) {
+	if (defined_vreg(code.insts[j]) == v.id)
+	    return false;
+    }
+    return true;
+}
+
+// if (c) r = x; else r = x; leaves only the second r = x
+static bool same_arms(IRCode& code, int i)
+{
+    if (i + 5 >= code.insts.size())
+	return false;
+
+    IRInst* arm = &code.insts[i];
+    if (arm[1].op != IR_LOAD || arm[2].op != IR_JUMP || arm[3].op != IR_LABEL
+	|| arm[4].op != IR_LOAD || arm[5].op != IR_LABEL)
+	return false;
+
+    return arm[3].dest == arm[0].src2 && arm[5].dest == arm[2].src1
+	&& arm[1].dest == arm[4].dest && arm[1].src1 == arm[4].src1;
+}
+
+static bool simplify(IRCode& code, int i)
+{
+    IRInst& inst = code.insts[i];
+    IRValue dest = inst.dest;
+    int result;
+
+    if (inst.op == IR_JUMP_ZERO || inst.op == IR_JUMP_NOT_ZERO)
+    {
+	if (inst.src1.is_const())
+	{
+	    bool taken = ((short)inst.src1.id == 0) == (inst.op == IR_JUMP_ZERO);
+	    inst = taken ? IRInst(IR_JUMP, IRValue(), inst.src2) : IRInst(IR_NOP);
+	    return true;
+	}
+
+	if (same_arms(code, i))
+	{
+	    code.insts[i] = code.insts[i + 1] = code.insts[i + 2] = IRInst(IR_NOP);
+	    return true;
+	}
+	return false;
+    }
+
+    if (!is_pure(inst.op))
+	return false;
+
+    if (inst.op == IR_LOAD)
+    {
+	if (inst.src1.is_const() && inst.src1.id != (short)inst.src1.id)
+	{
+	    inst.src1.id = (short)inst.src1.id;
+	    return true;
+	}
+	return false;
+    }
+
+    IRValue a = inst.src1, b = inst.src2;
+    if (a.is_const() && (!is_binary(inst.op) || b.is_const()) && fold_constant(inst.op, a.id, b.id, result))
+    {
+	inst = IRInst(IR_LOAD, dest, IRValue::constant(result));
+	return true;
+    }
+
+    if (!is_binary(inst.op))
+	return false;
+
+    if (a.is_const() && !b.is_const() && (is_commutative(inst.op) || is_compare(inst.op)))
+    {
+	inst = IRInst(swapped(inst.op), dest, b, a);
+	return true;
+    }
+
+    auto load = [&](IRValue v) {
+	inst = IRInst(IR_LOAD, dest, v);
+	return true;
+    };
+    auto negate = [&](IRValue v) {
+	inst = IRInst(IR_NEG, dest, v);
+	return true;
+    };
+    IRValue zero = IRValue::constant(0), one = IRValue::constant(1);
+
+    if (a.is_const() && (short)a.id == 0 && inst.op == IR_SUB)
+	return negate(b);
+
+    if (b.is_const())
+    {
+	short c = b.id;
+	switch (inst.op)
+	{
+	case IR_ADD:
+	case IR_SUB:
+	    if (c == 0) return load(a);
+	    break;
+	case IR_MUL:
+	    if (c == 0) return load(zero);
+	    if (c == 1) return load(a);
+	    if (c == -1) return negate(a);
+	    break;
+	case IR_DIV:
+	    if (c == 1) return load(a);
+	    if (c == -1) return negate(a);
+	    break;
+	case IR_MOD:
+	    if (c == 1 || c == -1) return load(zero);
+	    break;
+	case IR_BITAND:
+	    if (c == 0) return load(zero);
+	    if (c == -1) return load(a);
+	    break;
+	default:
+	    break;
+	}
+    }
+
+    if (a == b)
+    {
+	switch (inst.op)
+	{
+	case IR_SUB:
+	case IR_UNEQUAL:
+	case IR_LESS:
+	case IR_GREATER:
+	    return load(zero);
+	case IR_EQUAL:
+	case IR_GREATER_EQUAL:
+	case IR_LESS_EQUAL:
+	    return load(one);
+	case IR_BITAND:
+	    return load(a);
+	default:
+	    break;
+	}
+    }
+
+    // t = a < b; t == 0 is a >= b, t != 0 is a < b
+    if ((inst.op == IR_EQUAL || inst.op == IR_UNEQUAL) && a.is_vreg() && b == zero)
+    {
+	int j = local_def(code, i, a);
+	if (j != -1 && is_compare(code.insts[j].op))
+	{
+	    IRInst& cmp = code.insts[j];
+	    // not for t = t < b, which has overwritten the t it compared
+	    bool reads_own_dest = cmp.dest == cmp.src1 || cmp.dest == cmp.src2;
+	    if (!reads_own_dest && unchanged_between(code, j, i, cmp.src1) && unchanged_between(code, j, i, cmp.src2))
+	    {
+		inst = IRInst(inst.op == IR_EQUAL ? inverse(cmp.op) : cmp.op, dest, cmp.src1, cmp.src2);
+		return true;
+	    }
+	}
+    }
+
+    return false;
+}
+
+// one pass over the code, returns the number of instructions changed
+static int combine_pass(IRCode& code)
+{
+    int changed = 0;
+    map<int, int> constants;	// vreg -> the constant it holds in this block
+
+    for (int i = 0; i < code.insts.size(); i++) {
+	IRInst& inst = code.insts[i];
+	if (inst.op == IR_LABEL)
+	    constants.clear();
+
+	bool replaced = false;
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v.is_vreg() && constants.count(v.id))
+	    {
+		v = IRValue::constant(constants[v.id]);
+		replaced = true;
+	    }
+	});
+
+	if (simplify(code, i) || replaced)
+	    changed++;
+
+	int d = defined_vreg(code.insts[i]);
+	if (d != -1)
+	{
+	    constants.erase(d);
+	    if (code.insts[i].op == IR_LOAD && code.insts[i].src1.is_const())
+		constants[d] = code.insts[i].src1.id;
+	}
+    }
+
+    return changed;
+}
+
+int combine_instructions(IRCode& code)
+{
+    int total = 0;
+    int changed;
+    do {
+	changed = combine_pass(code);
+	total += changed;
+    } while (changed);
+
+    code.compact();
+    return total;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Instruction combining on the TACKY of one function, the way InstCombine
+// does it, repeated until nothing changes:
+//
+//   - a vreg loaded with a constant is replaced by the constant in the
+//     rest of its block
+//   - operations on constants are folded, with the 16 bit wraparound and
+//     the signed compares of the hardware
+//   - algebraic identities: x + 0, x * 1, x * 0, x - x, x & x, x == x, ...
+//   - !(a < b) becomes a >= b, !(a == b) becomes a != b
+//   - a conditional jump on a constant becomes a jump or is removed
+//   - c ? k : k becomes k
+//   - the constant of a commutative operation or of a compare is moved to
+//     the second operand, so that the first can be chained through A
+//
+// Instructions are rewritten in place, removed ones become IR_NOP and are
+// dropped at the end.
+//
+// Returns the number of instructions simplified.
+int combine_instructions(IRCode& code);
+
+// computes op on 16 bit values, false if it can not be done at compile time
+bool fold_constant(IROpcode op, int a, int b, int& result);
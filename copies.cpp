@@ -0,0 +1,153 @@
+#include "copies.hpp"
+
+#include <map>
+
+using namespace std;
+
+// how often every vreg is read in the whole function
+static vector<int> count_uses(IRCode& code)
+{
+    vector<int> uses(code.num_vregs(), 0);
+    for (IRInst& inst : code.insts) {
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v.is_vreg())
+		uses[v.id]++;
+	});
+    }
+    return uses;
+}
+
+// t = ...; x = t  ->  x = ...
+static int coalesce_moves(IRCode& code)
+{
+    int changed = 0;
+    vector<int> uses = count_uses(code);
+
+    // position in the current block of the last write, and of the last
+    // read or write, of every vreg. -1 if not in this block
+    vector<int> last_def(code.num_vregs(), -1);
+    vector<int> last_access(code.num_vregs(), -1);
+    int block_start = 0;
+
+    for (int i = 0; i < code.insts.size(); i++) {
+	IRInst& inst = code.insts[i];
+	// a block starts at a label and after a jump or return, as in the CFG
+	if (inst.op == IR_LABEL || (i > 0 && (is_branch(code.insts[i - 1].op) || code.insts[i - 1].op == IR_RETURN)))
+	    block_start = i;
+
+	auto in_block = [&](int pos) {
+	    return pos >= block_start;
+	};
+
+	if (inst.op == IR_LOAD && inst.src1.is_vreg() && inst.dest != inst.src1)
+	{
+	    int x = inst.dest.id, t = inst.src1.id;
+	    int j = last_def[t];
+	    if (uses[t] == 1 && j != -1 && in_block(j) && !(in_block(last_access[x]) && last_access[x] > j))
+	    {
+		code.insts[j].dest = inst.dest;
+		inst = IRInst(IR_NOP);
+		last_def[x] = last_access[x] = j;
+		uses[t] = 0;
+		changed++;
+		continue;
+	    }
+	}
+
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v.is_vreg())
+		last_access[v.id] = i;
+	});
+	int d = defined_vreg(inst);
+	if (d != -1)
+	    last_def[d] = last_access[d] = i;
+    }
+
+    return changed;
+}
+
+// x = y; ... x ...  ->  x = y; ... y ...
+static int forward_copies(IRCode& code)
+{
+    int changed = 0;
+    map<int, int> copy_of;		// x -> y
+    map<int, vector<int>> copies;	// y -> every x that may be a copy of it
+
+    for (IRInst& inst : code.insts) {
+	if (inst.op == IR_LABEL)
+	{
+	    copy_of.clear();
+	    copies.clear();
+	}
+
+	bool replaced = false;
+	for_each_use(code, inst, [&](IRValue& v) {
+	    auto it = v.is_vreg() ? copy_of.find(v.id) : copy_of.end();
+	    if (it != copy_of.end())
+	    {
+		v = IRValue::vreg(it->second);
+		replaced = true;
+	    }
+	});
+	changed += replaced;
+
+	int d = defined_vreg(inst);
+	if (d == -1)
+	    continue;
+
+	// the copies of d and the copy d was are no longer true
+	copy_of.erase(d);
+	for (int x : copies[d]) {
+	    auto it = copy_of.find(x);
+	    if (it != copy_of.end() && it->second == d)
+		copy_of.erase(it);
+	}
+	copies.erase(d);
+
+	if (inst.op == IR_LOAD && inst.src1.is_vreg() && inst.src1.id != d)
+	{
+	    copy_of[d] = inst.src1.id;
+	    copies[inst.src1.id].push_back(d);
+	}
+    }
+
+    return changed;
+}
+
+static int remove_dead_moves(IRCode& code)
+{
+    int removed = 0;
+    vector<int> uses = count_uses(code);
+
+    // going backwards, so that the moves feeding a removed move go too
+    for (int i = code.insts.size() - 1; i >= 0; i--) {
+	IRInst& inst = code.insts[i];
+	if (inst.op != IR_LOAD || !inst.dest.is_vreg())
+	    continue;
+
+	if (uses[inst.dest.id] == 0 || inst.dest == inst.src1)
+	{
+	    if (inst.src1.is_vreg())
+		uses[inst.src1.id]--;
+	    inst = IRInst(IR_NOP);
+	    removed++;
+	}
+    }
+
+    return removed;
+}
+
+int propagate_copies(IRCode& code)
+{
+    int total = 0;
+    int changed;
+    do {
+	changed = coalesce_moves(code);
+	changed += forward_copies(code);
+	changed += remove_dead_moves(code);
+	total += changed;
+    } while (changed);
+
+    code.compact();
+    return total;
+}
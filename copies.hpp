@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Copy propagation on the TACKY of one function, repeated until nothing
+// changes:
+//
+//   - t = a + b; x = t becomes x = a + b when t is read nowhere else, so
+//     that an assignment computes straight into its variable (this is
+//     also how call results reach their variable)
+//   - after x = y, the reads of x in the same block read y, as long as
+//     neither is written again
+//   - moves into vregs that are never read are removed
+//
+// Works on one basic block at a time, a label starts a new one.
+//
+// Returns the number of instructions changed or removed.
+int propagate_copies(IRCode& code);
@@ -0,0 +1,170 @@
+#include "dataflow.hpp"
+
+using namespace std;
+
+DataflowResult solve_gen_kill(CFG& cfg, int size, DataflowDirection direction, DataflowMeet meet,
+			      const BitVector& boundary, vector<GenKill>& blocks)
+{
+    return solve_dataflow(cfg, size, direction, meet, boundary,
+			  [&](int b, const BitVector& input, BitVector& output) {
+			      blocks[b].apply(input, output);
+			  });
+}
+
+static vector<GenKill> empty_transfers(CFG& cfg, int size)
+{
+    return vector<GenKill>(cfg.blocks.size(), GenKill{BitVector(size), BitVector(size)});
+}
+
+void live_step(IRCode& code, IRInst& inst, BitVector& live)
+{
+    int d = defined_vreg(inst);
+    if (d != -1)
+	live.reset(d);
+    for_each_use(code, inst, [&](IRValue& v) {
+	if (v.is_vreg())
+	    live.set(v.id);
+    });
+}
+
+DataflowResult live_variables(IRCode& code, CFG& cfg)
+{
+    int size = code.num_vregs();
+    vector<GenKill> blocks = empty_transfers(cfg, size);
+
+    // walking backwards, a use is exposed unless a later def hides it
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	GenKill& t = blocks[b];
+	for (int i = cfg.blocks[b].end; i >= cfg.blocks[b].start; i--) {
+	    IRInst& inst = code.insts[i];
+	    int d = defined_vreg(inst);
+	    if (d != -1)
+	    {
+		t.gen.reset(d);
+		t.kill.set(d);
+	    }
+	    for_each_use(code, inst, [&](IRValue& v) {
+		if (v.is_vreg())
+		    t.gen.set(v.id);
+	    });
+	}
+    }
+
+    return solve_gen_kill(cfg, size, BACKWARD, UNION, BitVector(size), blocks);
+}
+
+DataflowResult reaching_definitions(IRCode& code, CFG& cfg)
+{
+    int size = code.insts.size();
+    vector<vector<int>> defs_of(code.num_vregs());
+    for (int i = 0; i < size; i++) {
+	int d = defined_vreg(code.insts[i]);
+	if (d != -1)
+	    defs_of[d].push_back(i);
+    }
+
+    vector<GenKill> blocks = empty_transfers(cfg, size);
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	GenKill& t = blocks[b];
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    int d = defined_vreg(code.insts[i]);
+	    if (d == -1)
+		continue;
+	    for (int other : defs_of[d]) {
+		t.gen.reset(other);
+		t.kill.set(other);
+	    }
+	    t.gen.set(i);
+	}
+    }
+
+    return solve_gen_kill(cfg, size, FORWARD, UNION, BitVector(size), blocks);
+}
+
+static tuple<int, int, int, int, int> key_of(IRInst& inst)
+{
+    IRValue a = inst.src1, b = inst.src2;
+
+    // a + b and b + a are the same expression
+    bool commutative = inst.op == IR_ADD || inst.op == IR_MUL || inst.op == IR_BITAND
+	|| inst.op == IR_EQUAL || inst.op == IR_UNEQUAL;
+    if (commutative && make_pair(b.kind, b.id) < make_pair(a.kind, a.id))
+	swap(a, b);
+
+    return make_tuple(inst.op, a.kind, a.id, b.kind, b.id);
+}
+
+int ExpressionTable::find(IRInst& inst)
+{
+    if (!is_pure(inst.op) || inst.op == IR_LOAD)
+	return -1;
+
+    auto it = index.find(key_of(inst));
+    return it == index.end() ? -1 : it->second;
+}
+
+int ExpressionTable::add(IRInst& inst)
+{
+    if (!is_pure(inst.op) || inst.op == IR_LOAD)
+	return -1;
+
+    auto key = key_of(inst);
+    auto it = index.find(key);
+    if (it != index.end())
+	return it->second;
+
+    exprs.push_back(IRInst(inst.op, IRValue(), inst.src1, inst.src2));
+    index[key] = exprs.size() - 1;
+    return exprs.size() - 1;
+}
+
+void available_step(ExpressionTable& table, IRInst& inst, BitVector& available)
+{
+    int e = table.find(inst);
+    if (e != -1)
+	available.set(e);
+
+    // writing an operand kills the expression, even the one just computed
+    int d = defined_vreg(inst);
+    if (d == -1)
+	return;
+    for (int killed : table.readers[d])
+	available.reset(killed);
+}
+
+DataflowResult available_expressions(IRCode& code, CFG& cfg, ExpressionTable& table)
+{
+    for (IRInst& inst : code.insts)
+	table.add(inst);
+
+    int size = table.exprs.size();
+    table.readers.assign(code.num_vregs(), {});
+    for (int e = 0; e < size; e++) {
+	IRInst& expr = table.exprs[e];
+	if (expr.src1.is_vreg())
+	    table.readers[expr.src1.id].push_back(e);
+	if (is_binary(expr.op) && expr.src2.is_vreg() && expr.src2 != expr.src1)
+	    table.readers[expr.src2.id].push_back(e);
+    }
+
+    vector<GenKill> blocks = empty_transfers(cfg, size);
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	GenKill& t = blocks[b];
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    IRInst& inst = code.insts[i];
+	    int e = table.find(inst);
+	    if (e != -1)
+		t.gen.set(e);
+
+	    int d = defined_vreg(inst);
+	    if (d == -1)
+		continue;
+	    for (int killed : table.readers[d]) {
+		t.gen.reset(killed);
+		t.kill.set(killed);
+	    }
+	}
+    }
+
+    return solve_gen_kill(cfg, size, FORWARD, INTERSECTION, BitVector(size), blocks);
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <tuple>
+
+// Worklist solver for dataflow problems on bit vectors, and the analyses
+// the TACKY passes share.
+
+enum DataflowDirection
+{
+    FORWARD,			// facts flow from the entry along the edges
+    BACKWARD			// facts flow from the exits against the edges
+};
+
+enum DataflowMeet
+{
+    UNION,			// true on some path (may)
+    INTERSECTION		// true on all paths (must)
+};
+
+// the facts at the start and at the end of every block
+class DataflowResult
+{
+public:
+    vector<BitVector> in;
+    vector<BitVector> out;
+};
+
+// transfer(b, input, output) computes the facts on the other side of
+// block b: at its end for a forward problem, at its start for a
+// backward one. boundary are the facts at the entry, or at the exits
+template <typename Transfer>
+DataflowResult solve_dataflow(CFG& cfg, int size, DataflowDirection direction, DataflowMeet meet,
+			      const BitVector& boundary, Transfer transfer)
+{
+    int n = cfg.blocks.size();
+    bool forward = direction == FORWARD;
+
+    DataflowResult result;
+    result.in.assign(n, BitVector(size, meet == INTERSECTION));
+    result.out = result.in;
+
+    // the side the meet is on, and the side transfer computes
+    vector<BitVector>& before = forward ? result.in : result.out;
+    vector<BitVector>& after = forward ? result.out : result.in;
+
+    deque<int> worklist;
+    vector<bool> queued(n, true);
+    vector<int> order = cfg.reverse_postorder();
+    if (!forward)
+	reverse(order.begin(), order.end());
+    for (int b : order)
+	worklist.push_back(b);
+
+    // blocks not reachable from the entry keep the initial facts
+    vector<bool> reachable(n, false);
+    for (int b : order)
+	reachable[b] = true;
+
+    while (!worklist.empty()) {
+	int b = worklist.front();
+	worklist.pop_front();
+	queued[b] = false;
+
+	vector<int>& sources = forward ? cfg.blocks[b].preds : cfg.blocks[b].succs;
+	bool at_boundary = forward ? b == 0 : cfg.blocks[b].succs.empty();
+
+	BitVector facts = at_boundary ? boundary : BitVector(size, meet == INTERSECTION);
+	for (int s : sources) {
+	    if (!reachable[s])
+		continue;
+	    if (meet == UNION)
+		facts.unite(after[s]);
+	    else
+		facts.intersect(after[s]);
+	}
+	before[b] = facts;
+
+	BitVector computed(size);
+	transfer(b, before[b], computed);
+	if (computed == after[b])
+	    continue;
+	after[b] = computed;
+
+	vector<int>& targets = forward ? cfg.blocks[b].succs : cfg.blocks[b].preds;
+	for (int t : targets) {
+	    if (reachable[t] && !queued[t])
+	    {
+		queued[t] = true;
+		worklist.push_back(t);
+	    }
+	}
+    }
+
+    return result;
+}
+
+// the transfer function of most bit vector problems, output = gen | (input & ~kill)
+class GenKill
+{
+public:
+    BitVector gen;
+    BitVector kill;
+
+    void apply(const BitVector& input, BitVector& output) const
+    {
+	output = input;
+	output.subtract(kill);
+	output.unite(gen);
+    }
+};
+
+DataflowResult solve_gen_kill(CFG& cfg, int size, DataflowDirection direction, DataflowMeet meet,
+			      const BitVector& boundary, vector<GenKill>& blocks);
+
+// updates the vregs live before instruction inst, from those live after it
+void live_step(IRCode& code, IRInst& inst, BitVector& live);
+
+// vregs, live in and out of every block
+DataflowResult live_variables(IRCode& code, CFG& cfg);
+
+// instruction positions whose definition may reach the start and end of
+// every block. The params are defined before the entry, by no position
+DataflowResult reaching_definitions(IRCode& code, CFG& cfg);
+
+// the pure computations of the function, numbered for available_expressions
+class ExpressionTable
+{
+public:
+    vector<IRInst> exprs;	// dest is unused
+    map<tuple<int, int, int, int, int>, int> index;
+    vector<vector<int>> readers;	// the expressions reading every vreg
+
+    // the number of the expression inst computes, -1 if it is not one
+    int find(IRInst& inst);
+    int add(IRInst& inst);
+};
+
+// expressions computed on every path to the start and end of every block,
+// with none of their operands written since
+DataflowResult available_expressions(IRCode& code, CFG& cfg, ExpressionTable& table);
+
+// updates the expressions available after instruction inst, from those
+// available before it
+void available_step(ExpressionTable& table, IRInst& inst, BitVector& available);
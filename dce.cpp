@@ -0,0 +1,109 @@
+#include "dce.hpp"
+#include "dataflow.hpp"
+
+using namespace std;
+
+static int remove_unreachable(IRCode& code)
+{
+    code.compact();
+    CFG cfg(code);
+
+    vector<bool> reached(cfg.blocks.size(), false);
+    for (int b : cfg.reverse_postorder())
+	reached[b] = true;
+
+    int removed = 0;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	if (reached[b])
+	    continue;
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++)
+	    code.insts[i] = IRInst(IR_NOP);
+	removed += cfg.blocks[b].end - cfg.blocks[b].start + 1;
+    }
+    return removed;
+}
+
+// jmp L; L:  ->  L:
+static int remove_jumps_to_next(IRCode& code)
+{
+    int removed = 0;
+    for (int i = 0; i < code.insts.size(); i++) {
+	if (!is_branch(code.insts[i].op))
+	    continue;
+
+	IRValue target = branch_target(code.insts[i]);
+	for (int k = i + 1; k < code.insts.size(); k++) {
+	    IRInst& next = code.insts[k];
+	    if (next.op == IR_NOP)
+		continue;
+	    if (next.op != IR_LABEL)
+		break;
+	    if (next.dest == target)
+	    {
+		code.insts[i] = IRInst(IR_NOP);
+		removed++;
+		break;
+	    }
+	}
+    }
+    return removed;
+}
+
+static int remove_unused_labels(IRCode& code)
+{
+    vector<bool> targeted(code.labels.size(), false);
+    for (IRInst& inst : code.insts) {
+	if (is_branch(inst.op))
+	    targeted[branch_target(inst).id] = true;
+    }
+
+    int removed = 0;
+    for (IRInst& inst : code.insts) {
+	if (inst.op == IR_LABEL && !targeted[inst.dest.id])
+	{
+	    inst = IRInst(IR_NOP);
+	    removed++;
+	}
+    }
+    return removed;
+}
+
+static int remove_dead_instructions(IRCode& code)
+{
+    code.compact();
+    CFG cfg(code);
+    DataflowResult live = live_variables(code, cfg);
+
+    int removed = 0;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	BitVector live_after = live.out[b];
+	for (int i = cfg.blocks[b].end; i >= cfg.blocks[b].start; i--) {
+	    IRInst& inst = code.insts[i];
+	    int d = defined_vreg(inst);
+	    if (is_pure(inst.op) && d != -1 && !live_after.test(d))
+	    {
+		inst = IRInst(IR_NOP);
+		removed++;
+		continue;
+	    }
+	    live_step(code, inst, live_after);
+	}
+    }
+    return removed;
+}
+
+int eliminate_dead_code(IRCode& code)
+{
+    int total = 0;
+    int changed;
+    do {
+	changed = remove_unreachable(code);
+	changed += remove_jumps_to_next(code);
+	changed += remove_unused_labels(code);
+	changed += remove_dead_instructions(code);
+	total += changed;
+    } while (changed);
+
+    code.compact();
+    return total;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Dead code elimination on the TACKY of one function, repeated until
+// nothing changes:
+//
+//   - instructions that can not be reached from the entry are removed,
+//     like the code after a return or after the jump at the end of a loop
+//   - jumps to the label right after them are removed
+//   - labels that no jump goes to are removed
+//   - pure instructions whose dest is not live after them are removed
+//
+// Returns the number of instructions removed.
+int eliminate_dead_code(IRCode& code);
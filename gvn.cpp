@@ -0,0 +1,187 @@
+#include "gvn.hpp"
+#include "dataflow.hpp"
+
+#include <map>
+#include <tuple>
+
+using namespace std;
+
+static bool is_expensive(IROpcode op)
+{
+    return op == IR_MUL || op == IR_DIV || op == IR_MOD;
+}
+
+class ValueNumbering
+{
+public:
+    int next_number = 0;
+    map<int, int> vreg_number;
+    map<int, int> constant_number;
+    map<int, int> number_constant;
+    map<tuple<int, int, int>, int> expression_number;
+    map<int, vector<int>> holders; // number -> vregs that held it at some point
+    map<int, int> assigned_at;	// vreg -> the number of calls before it was written
+    int calls = 0;
+
+    int fresh()
+    {
+	return next_number++;
+    }
+
+    int number(IRValue v)
+    {
+	if (v.is_const())
+	{
+	    int c = (short)v.id;
+	    if (constant_number.count(c) == 0)
+	    {
+		constant_number[c] = fresh();
+		number_constant[constant_number[c]] = c;
+	    }
+	    return constant_number[c];
+	}
+
+	if (vreg_number.count(v.id) == 0)
+	    assign(v.id, fresh());
+	return vreg_number[v.id];
+    }
+
+    void assign(int vreg, int n)
+    {
+	vreg_number[vreg] = n;
+	holders[n].push_back(vreg);
+	assigned_at[vreg] = calls;
+    }
+
+    // a value that still has number n, none if nothing holds it any more.
+    // A vreg kept alive across a call has to be saved on the stack, which
+    // is only worth it for the expensive operations
+    bool holder(int n, IRValue& v, bool across_calls)
+    {
+	if (number_constant.count(n))
+	{
+	    v = IRValue::constant(number_constant[n]);
+	    return true;
+	}
+	for (int vreg : holders[n]) {
+	    if (vreg_number[vreg] == n && (across_calls || assigned_at[vreg] == calls))
+	    {
+		v = IRValue::vreg(vreg);
+		return true;
+	    }
+	}
+	return false;
+    }
+};
+
+static int number_block(IRCode& code, int start, int end)
+{
+    int removed = 0;
+    ValueNumbering numbering;
+
+    for (int i = start; i <= end; i++) {
+	IRInst& inst = code.insts[i];
+	int d = defined_vreg(inst);
+	if (d == -1)
+	    continue;
+
+	if (inst.op == IR_LOAD)
+	{
+	    numbering.assign(d, numbering.number(inst.src1));
+	    continue;
+	}
+	if (!is_pure(inst.op))
+	{
+	    numbering.calls += inst.op == IR_CALL;
+	    numbering.assign(d, numbering.fresh());
+	    continue;
+	}
+
+	int a = numbering.number(inst.src1);
+	int b = is_binary(inst.op) ? numbering.number(inst.src2) : -1;
+	if (is_commutative(inst.op) && b < a)
+	    swap(a, b);
+
+	auto key = make_tuple(inst.op, a, b);
+	auto it = numbering.expression_number.find(key);
+	IRValue previous;
+	if (it != numbering.expression_number.end() && numbering.holder(it->second, previous, is_expensive(inst.op)))
+	{
+	    inst = IRInst(IR_LOAD, inst.dest, previous);
+	    numbering.assign(d, it->second);
+	    removed++;
+	    continue;
+	}
+
+	int n = numbering.fresh();
+	numbering.expression_number[key] = n;
+	numbering.assign(d, n);
+    }
+
+    return removed;
+}
+
+static int eliminate_global(IRCode& code)
+{
+    CFG cfg(code);
+    ExpressionTable table;
+    DataflowResult available = available_expressions(code, cfg, table);
+
+    vector<bool> redundant(code.insts.size(), false);
+    vector<bool> reused(table.exprs.size(), false);
+    int removed = 0;
+
+    for (int b : cfg.reverse_postorder()) {
+	BitVector here = available.in[b];
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    IRInst& inst = code.insts[i];
+	    int e = table.find(inst);
+	    if (e != -1 && is_expensive(inst.op) && here.test(e))
+	    {
+		redundant[i] = reused[e] = true;
+		removed++;
+	    }
+	    available_step(table, inst, here);
+	}
+    }
+    if (removed == 0)
+	return 0;
+
+    // every computation of a reused expression also leaves it in a vreg of its own
+    vector<IRValue> saved(table.exprs.size());
+    for (int e = 0; e < table.exprs.size(); e++) {
+	if (reused[e])
+	    saved[e] = code.new_vreg("cse");
+    }
+
+    vector<IRInst> insts;
+    for (int i = 0; i < code.insts.size(); i++) {
+	IRInst inst = code.insts[i];
+	int e = table.find(inst);
+	if (e == -1 || !reused[e])
+	{
+	    insts.push_back(inst);
+	    continue;
+	}
+
+	if (!redundant[i])
+	    insts.push_back(IRInst(inst.op, saved[e], inst.src1, inst.src2));
+	insts.push_back(IRInst(IR_LOAD, inst.dest, saved[e]));
+    }
+    code.insts = insts;
+    return removed;
+}
+
+int eliminate_common_subexpressions(IRCode& code)
+{
+    code.compact();
+    if (code.insts.empty())
+	return 0;
+
+    int removed = 0;
+    CFG cfg(code);
+    for (CFGBlock& block : cfg.blocks)
+	removed += number_block(code, block.start, block.end);
+
+    return removed + eliminate_global(code);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Common subexpression elimination on the TACKY of one function.
+//
+// Every basic block is value numbered: a vreg gets the number of the
+// value it holds, copies share it, and a computation whose operation and
+// operand numbers were seen before becomes a move from a vreg that still
+// holds the result (a + b and b + a are the same). A cheap operation is
+// not reused across a call, where its vreg would have to be saved.
+//
+// Across blocks, a multiply, divide or modulo that is available on every
+// path to it (available_expressions) is replaced with a move from a new
+// vreg that every computation of it also writes. Only these are worth
+// it, for the cheap operations the extra move at the first computation
+// costs as much as the one saved.
+//
+// Returns the number of computations removed.
+int eliminate_common_subexpressions(IRCode& code);
@@ -0,0 +1,280 @@
+#include "inline.hpp"
+#include "loops.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+const int CALL_COST = 8;		// in TACKY instructions, plus one per arg
+const int LOOP_WEIGHT = 4;		// how many times more a call in a loop is taken to run
+const int MAX_SINGLE_CALL_SIZE = 200;
+const int MIN_BUDGET = 64;
+
+// the instructions a copy of the function adds
+static int body_size(IRCode& code)
+{
+    int size = 0;
+    for (IRInst& inst : code.insts) {
+	if (inst.op != IR_LABEL && inst.op != IR_NOP)
+	    size++;
+    }
+    return size;
+}
+
+// the index of the function a call goes to, -1 for an intrinsic
+static int callee_of(IRCode& code, IRInst& call, map<string, int>& index)
+{
+    auto it = index.find(code.labels[call.src1.id]);
+    return it == index.end() ? -1 : it->second;
+}
+
+static vector<vector<int>> call_graph(vector<IRCode>& functions, map<string, int>& index)
+{
+    vector<vector<int>> graph(functions.size());
+    for (int f = 0; f < functions.size(); f++) {
+	for (IRInst& inst : functions[f].insts) {
+	    int callee = inst.op == IR_CALL ? callee_of(functions[f], inst, index) : -1;
+	    if (callee != -1)
+		graph[f].push_back(callee);
+	}
+    }
+    return graph;
+}
+
+// Tarjan's strongly connected components of the call graph
+class CallCycles
+{
+public:
+    vector<vector<int>>& graph;
+    vector<int> component;	// of every function
+    vector<int> order;		// the functions, callees before callers
+
+    vector<int> number, low, stack;
+    vector<bool> on_stack;
+    int counter = 0;
+
+    CallCycles(vector<vector<int>>& _graph)
+	:
+	graph(_graph),
+	component(graph.size(), -1),
+	number(graph.size(), -1),
+	low(graph.size(), 0),
+	on_stack(graph.size(), false)
+    {
+	for (int f = 0; f < graph.size(); f++) {
+	    if (number[f] == -1)
+		visit(f);
+	}
+    }
+
+    void visit(int f)
+    {
+	number[f] = low[f] = counter++;
+	stack.push_back(f);
+	on_stack[f] = true;
+
+	for (int callee : graph[f]) {
+	    if (number[callee] == -1)
+	    {
+		visit(callee);
+		low[f] = min(low[f], low[callee]);
+	    }
+	    else if (on_stack[callee])
+		low[f] = min(low[f], number[callee]);
+	}
+
+	if (low[f] != number[f])
+	    return;
+
+	// f is the first of a component, the rest are above it on the stack
+	int g;
+	do {
+	    g = stack.back();
+	    stack.pop_back();
+	    on_stack[g] = false;
+	    component[g] = f;
+	    order.push_back(g);
+	} while (g != f);
+    }
+};
+
+// replaces the call at position at with a copy of callee
+static void inline_call(IRCode& caller, int at, IRCode& callee, int site)
+{
+    IRInst call = caller.insts[at];
+    vector<IRValue> args = caller.call_args[call.src2.id];
+    string suffix = ".inline" + to_string(site);
+
+    vector<IRValue> vregs;
+    for (string name : callee.var_names)
+	vregs.push_back(caller.new_vreg(name));
+
+    map<int, IRValue> labels;
+    auto label = [&](IRValue l) {
+	if (labels.count(l.id) == 0)
+	    labels[l.id] = caller.label(callee.labels[l.id] + suffix);
+	return labels[l.id];
+    };
+    auto value = [&](IRValue v) {
+	return v.is_vreg() ? vregs[v.id] : v;
+    };
+
+    IRValue end = caller.label(callee.name + suffix);
+    vector<IRInst> copy;
+    for (int i = 0; i < callee.num_params; i++)
+	copy.push_back(IRInst(IR_LOAD, vregs[i], args[i]));
+
+    for (IRInst inst : callee.insts) {
+	switch (inst.op)
+	{
+	case IR_NOP:
+	    continue;
+	case IR_LABEL:
+	    inst.dest = label(inst.dest);
+	    break;
+	case IR_JUMP:
+	    inst.src1 = label(inst.src1);
+	    break;
+	case IR_JUMP_ZERO:
+	case IR_JUMP_NOT_ZERO:
+	    inst.src1 = value(inst.src1);
+	    inst.src2 = label(inst.src2);
+	    break;
+	case IR_RETURN:
+	    if (call.dest.is_vreg())
+		copy.push_back(IRInst(IR_LOAD, call.dest, value(inst.src1)));
+	    inst = IRInst(IR_JUMP, IRValue(), end);
+	    break;
+	case IR_CALL:
+	{
+	    vector<IRValue> call_args;
+	    for (IRValue arg : callee.call_args[inst.src2.id])
+		call_args.push_back(value(arg));
+	    inst.dest = value(inst.dest);
+	    inst.src1 = caller.label(callee.labels[inst.src1.id]);
+	    inst.src2 = caller.args(call_args);
+	    break;
+	}
+	default:
+	    inst.dest = value(inst.dest);
+	    inst.src1 = value(inst.src1);
+	    inst.src2 = value(inst.src2);
+	    break;
+	}
+	copy.push_back(inst);
+    }
+    copy.push_back(IRInst(IR_LABEL, end));
+
+    caller.insts.erase(caller.insts.begin() + at);
+    caller.insts.insert(caller.insts.begin() + at, copy.begin(), copy.end());
+}
+
+// the instructions of code that are in a loop
+static vector<bool> in_loops(IRCode& code)
+{
+    vector<bool> result(code.insts.size(), false);
+    CFG cfg(code);
+    DominatorTree dom(cfg);
+    for (Loop& loop : find_loops(cfg, dom)) {
+	for (int b = 0; b < cfg.blocks.size(); b++) {
+	    if (!loop.body[b])
+		continue;
+	    for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++)
+		result[i] = true;
+	}
+    }
+    return result;
+}
+
+int inline_functions(vector<IRCode>& functions, bool whole_program)
+{
+    map<string, int> index;
+    for (int f = 0; f < functions.size(); f++) {
+	functions[f].compact();
+	index[functions[f].name] = f;
+    }
+
+    vector<vector<int>> graph = call_graph(functions, index);
+    CallCycles cycles(graph);
+
+    vector<int> calls(functions.size(), 0);
+    int total = 0;
+    for (int f = 0; f < functions.size(); f++) {
+	total += body_size(functions[f]);
+	for (int callee : graph[f])
+	    calls[callee]++;
+    }
+    int budget = max(MIN_BUDGET, total / 4), growth = 0;
+
+    int inlined = 0;
+    for (int f : cycles.order) {
+	IRCode& caller = functions[f];
+	if (caller.insts.empty())
+	    continue;
+	vector<bool> in_loop = in_loops(caller);
+
+	// from the end, so the positions before a site stay the same
+	for (int i = caller.insts.size() - 1; i >= 0; i--) {
+	    if (caller.insts[i].op != IR_CALL)
+		continue;
+	    int c = callee_of(caller, caller.insts[i], index);
+	    if (c == -1 || cycles.component[c] == cycles.component[f] || functions[c].name == "main")
+		continue;
+
+	    IRCode& callee = functions[c];
+	    if (caller.call_args[caller.insts[i].src2.id].size() != callee.num_params)
+		continue;
+
+	    int size = body_size(callee);
+	    int cost = CALL_COST + callee.num_params;
+	    bool only_call = whole_program && calls[c] == 1 && size <= MAX_SINGLE_CALL_SIZE;
+	    if (!only_call && size > (in_loop[i] ? cost * LOOP_WEIGHT : cost))
+		continue;
+
+	    // the callee goes away after its only call is inlined
+	    int extra = only_call ? -cost : size - cost;
+	    if (extra > 0 && growth + extra > budget)
+		continue;
+
+	    growth += extra;
+	    calls[c]--;
+	    for (IRInst& inst : callee.insts) {
+		int copied = inst.op == IR_CALL ? callee_of(callee, inst, index) : -1;
+		if (copied != -1)
+		    calls[copied]++;
+	    }
+
+	    inline_call(caller, i, callee, inlined);
+	    inlined++;
+	}
+    }
+
+    return inlined;
+}
+
+vector<bool> reachable_functions(vector<IRCode>& functions, string entry)
+{
+    map<string, int> index;
+    for (int f = 0; f < functions.size(); f++)
+	index[functions[f].name] = f;
+
+    if (index.count(entry) == 0)
+	return vector<bool>(functions.size(), true);
+
+    vector<bool> reached(functions.size(), false);
+    vector<int> work = {index[entry]};
+    while (!work.empty()) {
+	int f = work.back();
+	work.pop_back();
+	if (reached[f])
+	    continue;
+
+	reached[f] = true;
+	for (IRInst& inst : functions[f].insts) {
+	    int callee = inst.op == IR_CALL ? callee_of(functions[f], inst, index) : -1;
+	    if (callee != -1)
+		work.push_back(callee);
+	}
+    }
+    return reached;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Inlining of calls between the functions of one program, on TACKY.
+//
+// A call is replaced with a copy of the callee: its vregs and labels get
+// new names in the caller, the args are loaded into the copies of the
+// params and each return becomes a load into the dest of the call and a
+// jump past the copy. Callees are done before their callers, so what was
+// inlined into a callee is inlined along with it.
+//
+// Whether a call is inlined depends on the size of the callee against
+// what the call costs, a call in a loop counting for more. Calls within
+// a cycle of the call graph are never inlined, and the growth of the
+// whole program is kept under a budget. If whole_program is set, no
+// other code can call these functions, so a callee with a single call
+// is inlined whatever its size (it is dropped afterwards).
+//
+// Returns the number of calls inlined.
+int inline_functions(vector<IRCode>& functions, bool whole_program);
+
+// the functions entry calls, directly or not, and entry itself. All of
+// them if there is no entry
+vector<bool> reachable_functions(vector<IRCode>& functions, string entry);
@@ -0,0 +1,83 @@
+#include "intrinsics.hpp"
+#include "mcc.hpp"
+
+#include <filesystem>
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+// generated from intrinsics/*.s by the makefile
+extern const vector<pair<string, string>> embedded_intrinsic_sources;
+
+// the targets of the "subr2 name" calls in an intrinsic
+vector<string> called_functions(string source)
+{
+    vector<string> result;
+    stringstream lines(source);
+    for (string line; getline(lines, line);) {
+	stringstream words(line.substr(0, line.find(';')));
+	string mnemonic, target;
+	if (words >> mnemonic >> target && mnemonic == "subr2")
+	    result.push_back(target);
+    }
+    return result;
+}
+
+IntrinsicLibrary::IntrinsicLibrary(vector<pair<string, string>> sources)
+{
+    for (auto& source : sources) {
+	intrinsics[source.first] = Intrinsic{source.first, source.second, {}};
+    }
+
+    // close over the calls, so users of an intrinsic need no further lookups
+    for (auto& entry : intrinsics) {
+	set<string> seen;
+	vector<string> work = called_functions(entry.second.source);
+	while (!work.empty()) {
+	    string name = work.back();
+	    work.pop_back();
+	    if (name == entry.first || seen.count(name) || !provides(name))
+		continue;
+
+	    seen.insert(name);
+	    for (string callee : called_functions(intrinsics[name].source))
+		work.push_back(callee);
+	}
+	entry.second.dependencies = vector<string>(seen.begin(), seen.end());
+    }
+}
+
+bool IntrinsicLibrary::provides(string name) const
+{
+    return intrinsics.find(name) != intrinsics.end();
+}
+
+const Intrinsic* IntrinsicLibrary::find(string name) const
+{
+    auto it = intrinsics.find(name);
+    if (it == intrinsics.end())
+	return nullptr;
+    return &it->second;
+}
+
+const IntrinsicLibrary& IntrinsicLibrary::embedded()
+{
+    static const IntrinsicLibrary library(embedded_intrinsic_sources);
+    return library;
+}
+
+IntrinsicLibrary IntrinsicLibrary::load(string dir)
+{
+    vector<pair<string, string>> sources;
+    error_code error;
+    for (auto& entry : filesystem::directory_iterator(dir, error)) {
+	if (entry.path().extension() == ".s")
+	    sources.push_back({entry.path().stem().string(), read_file(entry.path().string())});
+    }
+
+    if (error)
+	throw CompileError("cannot read intrinsics directory " + dir + ": " + error.message(), 0, 0, 0);
+
+    return IntrinsicLibrary(sources);
+}
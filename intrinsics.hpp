@@ -0,0 +1,39 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// an intrinsic function, written in assembly
+class Intrinsic
+{
+public:
+    string name;
+    string source;
+    vector<string> dependencies;	// every intrinsic it calls, directly or not
+};
+
+// The intrinsics available to a compilation. By default these are the
+// sources in intrinsics/, compiled into the binary by the makefile (see
+// embedded_intrinsics.cpp), a directory of .s files can replace them.
+class IntrinsicLibrary
+{
+public:
+    map<string, Intrinsic> intrinsics;
+
+    // sources is name -> assembly, resolves the dependencies of each
+    IntrinsicLibrary(vector<pair<string, string>> sources = {});
+
+    bool provides(string name) const;
+
+    // nullptr if there is no such intrinsic
+    const Intrinsic* find(string name) const;
+
+    // the library compiled into the binary, built once
+    static const IntrinsicLibrary& embedded();
+
+    // every name.s in dir, throws CompileError if dir cannot be read
+    static IntrinsicLibrary load(string dir);
+};
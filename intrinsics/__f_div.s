@@ -1,67 +1,129 @@
+	;; restoring divide, r1 / r2 rounded towards 0 like C, the
+	;; quotient goes in r0 and the remainder (sign of r1) in r8
 __f_div:
-	
-	ldri %r0 0		;push 0 onto the stack
-	pushr %r0		;this denotes stop condition for subtraction
-	pushr2 %r0
-	
-	ldar %r2		;load denominator into A reg
+	ldri %r0 0		;1 if the quotient is negative
+	ldri %r4 0		;1 if the remainder is negative
 
-intrinsic-div_loop:
-	ldbr %r1		;load numerator for checking magnitude
+	ldar %r2		;the magnitude of -32768 does not fit, so it is done apart
+	ldbi 0x8000
 	cmp
+	je intrinsic-div_min
 
-	
-	jg intrinsic-div_exit			;if shifted denominator greater than numerator, exit the loop
-
-	pushr %r2		;else push it
-	pushr2 %r2
-	
-	ldar %r2		;load a reg again as pushr clobbers it
-	shl			;shift it left
+	ldai 0			;make the denominator positive
+	ldbr %r2
+	cmp
+	jl intrinsic-div_denominator_positive
+	sub
+	ldra %r2
+	ldri %r0 1
 
-	ldra %r2		;put result back in r2
+intrinsic-div_denominator_positive:
+	ldai 0			;and the numerator, this one can be 0x8000 as it is only shifted
+	ldbr %r1
+	cmp
+	jl intrinsic-div_numerator_positive
+	sub
+	ldra %r1
+	ldri %r4 1
 
-	
-	jmp intrinsic-div_loop
+	ldai 1			;flip the sign of the quotient
+	ldbr %r0
+	sub
+	ldra %r0
 
-intrinsic-div_exit:
-	ldri %r0 0		; initialize r0 as quotient
-	ldri %r8 0		; initialize r8 as remainder 
+intrinsic-div_numerator_positive:
+	ldri %r8 0		;the partial remainder
+	ldri %r3 16		;one iteration per bit
 
-intrinsic-div_loop2:
-	popr %r2		;pop the last 
-	popr2 %r2
+intrinsic-div_loop:
+	ldar %r8		;shift the top bit of the numerator into the remainder
+	shl
+	ldra %r8
 
-	ldbr %r2		;load subtrahend
-	ldai 0			;check if its 0, if so then exit loop
+	ldai -1
+	ldbr %r1
 	cmp
-	
-	je intrinsic-div_end
+	jl intrinsic-div_shift	;top bit not set
 
-	ldar %r0		;left shift quotient
+	ldar %r8
+	ldbi 1
+	add
+	ldra %r8
+
+intrinsic-div_shift:
+	ldar %r1		;the quotient bits come in at the bottom of the numerator
 	shl
-	ldra %r0
-	
-	ldar %r1		;load numerator, as denom is already loaded
-	ldbr %r2		;load subtrahend
+	ldra %r1
+
+	ldar %r8		;cmp is signed, a remainder with the top bit set is above any denominator
+	ldbi 0
 	cmp
-	
-	jl intrinsic-div_loop2		;if numerator is less than subtrahend, then go to next iteration
-	sub			;else subtract it
+	jl intrinsic-div_subtract
 
-	ldra %r1		;put result back into numerator slot
+	ldbr %r2
+	cmp
+	jl intrinsic-div_next	;remainder less than the denominator, the bit is 0
+
+intrinsic-div_subtract:
+	ldar %r8
+	ldbr %r2
+	sub
+	ldra %r8
 
-	ldar %r0		;add 1 to the quotient
-	ldbi 1			;before it is left shifted
+	ldar %r1
+	ldbi 1
 	add
+	ldra %r1
+
+intrinsic-div_next:
+	ldar %r3
+	ldbi 1
+	sub
+	ldra %r3
+	ldbi 0
+	cmp
+	jg intrinsic-div_loop
+
+	ldar %r0		;put the signs back
+	ldbi 0
+	cmp
+	je intrinsic-div_quotient_positive
+	ldai 0
+	ldbr %r1
+	sub
+	ldra %r1
+
+intrinsic-div_quotient_positive:
+	ldar %r1
 	ldra %r0
-	
-	jmp intrinsic-div_loop2
+
+	ldar %r4
+	ldbi 0
+	cmp
+	je intrinsic-div_end
+	ldai 0
+	ldbr %r8
+	sub
+	ldra %r8
 
 intrinsic-div_end:
+	ret
+	ret2
+
+intrinsic-div_min:
+	ldar %r1		;only -32768 itself goes into -32768
+	ldbi 0x8000
+	cmp
+	je intrinsic-div_min_itself
+
+	ldri %r0 0
 	ldar %r1
-	ldra %r8		;put the remaining numerator into the remainder slot
-	;; quotient is already filled into r0
+	ldra %r8
+	ret
+	ret2
+
+intrinsic-div_min_itself:
+	ldri %r0 1
+	ldri %r8 0
 	ret
 	ret2
-	
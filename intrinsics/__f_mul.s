@@ -0,0 +1,57 @@
+	;; shift and add multiply, r0 = r1 * r2 (the low 16 bits, so it
+	;; does not matter whether the operands are signed)
+__f_mul:
+	ldri %r0 0		;the product so far
+
+	ldai -1			;a negative multiplier would take all 16 bits to use up
+	ldbr %r2
+	cmp
+	jl intrinsic-mul_start	;so use -r1 * -r2 instead
+
+	ldai 0
+	sub
+	ldra %r2
+	ldai 0
+	ldbr %r1
+	sub
+	ldra %r1
+
+intrinsic-mul_start:
+	ldri %r3 1		;the bit of the multiplier being looked at
+
+intrinsic-mul_loop:
+	ldar %r2		;the bits are cleared as they are used, so stop when none are left
+	ldbi 0
+	cmp
+	je intrinsic-mul_end
+
+	ldbr %r3
+	and
+	ldbi 0
+	cmp
+	je intrinsic-mul_next	;bit not set, nothing to add
+
+	ldar %r2		;clear the bit
+	ldbr %r3
+	sub
+	ldra %r2
+
+	ldar %r0		;add the multiplicand, which is shifted along with the bit
+	ldbr %r1
+	add
+	ldra %r0
+
+intrinsic-mul_next:
+	ldar %r1
+	shl
+	ldra %r1
+
+	ldar %r3
+	shl
+	ldra %r3
+
+	jmp intrinsic-mul_loop
+
+intrinsic-mul_end:
+	ret
+	ret2
@@ -0,0 +1,61 @@
+	;; arithmetic shift right, r0 = r1 >> r2 for r2 from 1 to 15
+	;; there is no shr, so r1 is rotated left 16 - r2 times instead
+__f_sar:
+	ldai 16
+	ldbr %r2
+	sub
+	ldra %r3		;rotations left
+
+	ldar %r1
+	ldra %r0
+	ldri %r4 0		;gets a 1 for each rotation, to mask off the bits that went round
+
+intrinsic-sar_loop:
+	ldar %r4
+	shl
+	ldbi 1
+	add
+	ldra %r4
+
+	ldar %r0		;rotate, the top bit comes in at the bottom
+	ldbi 0
+	cmp
+	jl intrinsic-sar_carry
+	shl
+	ldra %r0
+	jmp intrinsic-sar_next
+
+intrinsic-sar_carry:
+	shl
+	ldbi 1
+	add
+	ldra %r0
+
+intrinsic-sar_next:
+	ldar %r3
+	ldbi 1
+	sub
+	ldra %r3
+	ldbi 0
+	cmp
+	jg intrinsic-sar_loop
+
+	ldar %r0
+	ldbr %r4
+	and
+	ldra %r0
+
+	ldai -1			;fill the top with the sign of r1
+	ldbr %r1
+	cmp
+	jl intrinsic-sar_end
+	ldai -1
+	ldbr %r4
+	sub
+	ldbr %r0
+	add
+	ldra %r0
+
+intrinsic-sar_end:
+	ret
+	ret2
@@ -0,0 +1,165 @@
+#include "ircode.hpp"
+#include "tacky.hpp"
+
+using namespace std;
+
+const char* opcode_name(IROpcode op)
+{
+    static const char* names[] = {
+	"Nop", "Load", "Neg", "Not", "Add", "Sub", "Mul", "Div", "Mod", "BitAnd",
+	"Equal", "Unequal", "GreaterEqual", "LessEqual", "Less", "Greater",
+	"Jump", "JumpZero", "JumpNotZero", "Label", "Return", "Funcall"
+    };
+    return names[op];
+}
+
+void IRCode::compact()
+{
+    int out = 0;
+    for (int i=0;i<insts.size();i++)
+    {
+	if (insts[i].op != IR_NOP)
+	    insts[out++] = insts[i];
+    }
+    insts.resize(out);
+}
+
+void IRCode::print_value(ostream& out, IRValue v)
+{
+    switch (v.kind)
+    {
+    case VAL_VREG:
+	out << "v" << v.id;
+	break;
+    case VAL_CONST:
+	out << "$" << v.id;
+	break;
+    case VAL_LABEL:
+	out << labels[v.id];
+	break;
+    case VAL_ARGS:
+	out << "(";
+	for (int i=0;i<call_args[v.id].size();i++)
+	{
+	    if (i)
+		out << ", ";
+	    print_value(out, call_args[v.id][i]);
+	}
+	out << ")";
+	break;
+    case VAL_NONE:
+	break;
+    }
+}
+
+void IRCode::pretty_print(ostream& out)
+{
+    out << "Code " << name << " (" << num_params << " params, " << num_vregs() << " vregs)" << endl;
+
+    for (IRInst& inst : insts)
+    {
+	if (inst.op == IR_LABEL)
+	{
+	    print_value(out, inst.dest);
+	    out << ":" << endl;
+	    continue;
+	}
+
+	out << "\t" << opcode_name(inst.op);
+
+	IRValue fields[] = { inst.dest, inst.src1, inst.src2 };
+	bool first = true;
+	for (IRValue v : fields)
+	{
+	    if (v.kind == VAL_NONE)
+		continue;
+
+	    out << (first ? " " : ", ");
+	    print_value(out, v);
+	    first = false;
+	}
+	out << endl;
+    }
+    out << endl;
+}
+
+IRValue IRVar::to_value(IRCode& code)
+{
+    return IRValue::vreg(id);
+}
+
+IRValue IRConst::to_value(IRCode& code)
+{
+    return IRValue::constant(value);
+}
+
+IROperand* decode_operand(IRValue v)
+{
+    if (v.kind == VAL_CONST)
+	return new IRConst(v.id);
+
+    return new IRVar(v.id);
+}
+
+// builds the IRNode for one record, the inverse of IRNode::encode
+IRNode* decode_inst(IRCode& code, IRInst& inst)
+{
+    IROperand* dest = inst.dest.is_vreg() ? decode_operand(inst.dest) : nullptr;
+
+    switch (inst.op)
+    {
+    case IR_LOAD:		return new IRLoad(dest, decode_operand(inst.src1));
+    case IR_NEG:		return new IRNeg(dest, decode_operand(inst.src1));
+    case IR_NOT:		return new IRNot(dest, decode_operand(inst.src1));
+    case IR_ADD:		return new IRAdd(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_SUB:		return new IRSub(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_MUL:		return new IRMul(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_DIV:		return new IRDiv(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_MOD:		return new IRMod(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_BITAND:		return new IRBitAnd(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_EQUAL:		return new IREqual(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_UNEQUAL:		return new IRUnequal(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_GREATER_EQUAL:	return new IRGreaterEqual(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_LESS_EQUAL:		return new IRLessEqual(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_LESS:		return new IRLess(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_GREATER:		return new IRGreater(dest, decode_operand(inst.src1), decode_operand(inst.src2));
+    case IR_JUMP:		return new IRJump(code.labels[inst.src1.id]);
+    case IR_JUMP_ZERO:		return new IRJumpZero(decode_operand(inst.src1), code.labels[inst.src2.id]);
+    case IR_JUMP_NOT_ZERO:	return new IRJumpNotZero(decode_operand(inst.src1), code.labels[inst.src2.id]);
+    case IR_LABEL:		return new IRLabel(code.labels[inst.dest.id]);
+    case IR_RETURN:		return new IRReturn(decode_operand(inst.src1));
+    case IR_CALL:
+    {
+	vector<IROperand*> args;
+	for (IRValue arg : code.call_args[inst.src2.id]) {
+	    args.push_back(decode_operand(arg));
+	}
+	return new IRFunctionCall(code.labels[inst.src1.id], dest, args);
+    }
+    default:
+	return nullptr;
+    }
+}
+
+IRCode IRFunction::encode()
+{
+    IRCode code(name, params.size());
+    code.var_names = var_names;
+
+    for (IRNode* s : body) {
+	s->encode(code);
+    }
+    return code;
+}
+
+void IRFunction::decode(IRCode& code)
+{
+    body.clear();
+    for (IRInst& inst : code.insts)
+    {
+	IRNode* node = decode_inst(code, inst);
+	if (node)
+	    body.push_back(node);
+    }
+    var_names = code.var_names;
+}
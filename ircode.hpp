@@ -0,0 +1,215 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+
+using namespace std;
+
+// Dense encoding of the TACKY of one function.
+//
+// Every instruction is a fixed size record of an opcode, a destination
+// and two sources, stored contiguously so that passes walk and rewrite
+// the IR with linear scans instead of chasing IRNode pointers.
+
+enum IROpcode : unsigned char
+{
+    IR_NOP,			// deleted instruction, dropped by compact()
+    IR_LOAD,			// dest = src1
+    IR_NEG,			// dest = -src1
+    IR_NOT,			// dest = ~src1
+    IR_ADD,			// dest = src1 + src2
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_BITAND,
+    IR_EQUAL,			// dest = src1 == src2
+    IR_UNEQUAL,
+    IR_GREATER_EQUAL,
+    IR_LESS_EQUAL,
+    IR_LESS,
+    IR_GREATER,
+    IR_JUMP,			// goto src1
+    IR_JUMP_ZERO,		// if src1 == 0 goto src2
+    IR_JUMP_NOT_ZERO,		// if src1 != 0 goto src2
+    IR_LABEL,			// dest is the label
+    IR_RETURN,			// return src1
+    IR_CALL			// dest = src1(args src2)
+};
+
+enum IRValueKind : unsigned char
+{
+    VAL_NONE,
+    VAL_VREG,			// id is the vreg
+    VAL_CONST,			// id is the value
+    VAL_LABEL,			// id indexes IRCode::labels
+    VAL_ARGS			// id indexes IRCode::call_args
+};
+
+class IRValue
+{
+public:
+    IRValueKind kind;
+    int id;
+
+    IRValue(IRValueKind _kind=VAL_NONE, int _id=0)
+    :
+	kind(_kind),
+	id(_id)
+    {}
+
+    static IRValue vreg(int v) { return IRValue(VAL_VREG, v); }
+    static IRValue constant(int c) { return IRValue(VAL_CONST, c); }
+    static IRValue label(int l) { return IRValue(VAL_LABEL, l); }
+
+    bool is_vreg() const { return kind == VAL_VREG; }
+    bool is_const() const { return kind == VAL_CONST; }
+
+    bool operator==(const IRValue& other) const { return kind == other.kind && id == other.id; }
+    bool operator!=(const IRValue& other) const { return !(*this == other); }
+};
+
+class IRInst
+{
+public:
+    IROpcode op;
+    IRValue dest;
+    IRValue src1;
+    IRValue src2;
+
+    IRInst(IROpcode _op=IR_NOP, IRValue _dest=IRValue(), IRValue _src1=IRValue(), IRValue _src2=IRValue())
+    :
+	op(_op),
+	dest(_dest),
+	src1(_src1),
+	src2(_src2)
+    {}
+};
+
+class IRCode
+{
+public:
+    string name;
+    int num_params;		// the params are vregs 0 to num_params-1
+    vector<IRInst> insts;
+    vector<string> var_names;	// debug name of every vreg
+    vector<string> labels;	// name of every label and callee
+    map<string, int> label_ids;
+    vector<vector<IRValue>> call_args;
+
+    IRCode(string _name="", int _num_params=0)
+    :
+	name(_name),
+	num_params(_num_params)
+    {}
+
+    int num_vregs() { return var_names.size(); }
+
+    IRValue new_vreg(string debug_name)
+    {
+	var_names.push_back(debug_name);
+	return IRValue::vreg(var_names.size() - 1);
+    }
+
+    // interns a label or function name
+    IRValue label(string name)
+    {
+	auto it = label_ids.find(name);
+	if (it != label_ids.end())
+	    return IRValue::label(it->second);
+
+	labels.push_back(name);
+	label_ids[name] = labels.size() - 1;
+	return IRValue::label(labels.size() - 1);
+    }
+
+    IRValue args(vector<IRValue> values)
+    {
+	call_args.push_back(values);
+	return IRValue(VAL_ARGS, call_args.size() - 1);
+    }
+
+    void push_back(IRInst inst)
+    {
+	insts.push_back(inst);
+    }
+
+    // drops the IR_NOPs left behind by passes
+    void compact();
+
+    void pretty_print(ostream& out);
+    void print_value(ostream& out, IRValue v);
+};
+
+const char* opcode_name(IROpcode op);
+
+inline bool is_binary(IROpcode op)
+{
+    return op >= IR_ADD && op <= IR_GREATER;
+}
+
+// a op b is b op a
+inline bool is_commutative(IROpcode op)
+{
+    return op == IR_ADD || op == IR_MUL || op == IR_BITAND || op == IR_EQUAL || op == IR_UNEQUAL;
+}
+
+inline bool is_unary(IROpcode op)
+{
+    return op == IR_LOAD || op == IR_NEG || op == IR_NOT;
+}
+
+inline bool is_branch(IROpcode op)
+{
+    return op == IR_JUMP || op == IR_JUMP_ZERO || op == IR_JUMP_NOT_ZERO;
+}
+
+// instructions that only compute their dest and can be removed or moved freely
+inline bool is_pure(IROpcode op)
+{
+    return is_unary(op) || is_binary(op);
+}
+
+// the label a branch goes to
+inline IRValue branch_target(IRInst& inst)
+{
+    return inst.op == IR_JUMP ? inst.src1 : inst.src2;
+}
+
+// the vreg written by an instruction, -1 if none
+inline int defined_vreg(IRInst& inst)
+{
+    if (inst.op == IR_LABEL || !inst.dest.is_vreg())
+	return -1;
+    return inst.dest.id;
+}
+
+// calls f on every value the instruction reads, call arguments included
+template <typename F>
+void for_each_use(IRCode& code, IRInst& inst, F f)
+{
+    switch (inst.op)
+    {
+    case IR_NOP:
+    case IR_LABEL:
+    case IR_JUMP:
+	break;
+    case IR_CALL:
+	for (IRValue& arg : code.call_args[inst.src2.id]) {
+	    f(arg);
+	}
+	break;
+    case IR_JUMP_ZERO:
+    case IR_JUMP_NOT_ZERO:
+    case IR_RETURN:
+	f(inst.src1);
+	break;
+    default:
+	f(inst.src1);
+	if (is_binary(inst.op))
+	    f(inst.src2);
+	break;
+    }
+}
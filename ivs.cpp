@@ -0,0 +1,167 @@
+#include "ivs.hpp"
+#include "loops.hpp"
+
+using namespace std;
+
+// i = i + step, at position def
+class InductionVariable
+{
+public:
+    int def = -1;
+    IRValue step;
+};
+
+// reduces the multiplies of one loop that no inner loop has, returns
+// how many. The changes to the code go in edits and preheaders
+static int reduce_loop(IRCode& code, CFG& cfg, Loop& loop, map<int, vector<IRInst>>& edits,
+		       vector<Preheader>& preheaders)
+{
+    vector<int> writes(code.num_vregs(), 0);
+    vector<int> multiplies;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	if (!loop.body[b])
+	    continue;
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    int d = defined_vreg(code.insts[i]);
+	    if (d != -1)
+		writes[d]++;
+	    if (code.insts[i].op == IR_MUL && edits.count(i) == 0)
+		multiplies.push_back(i);
+	}
+    }
+    if (multiplies.empty())
+	return 0;
+
+    auto invariant = [&](IRValue v) {
+	return !v.is_vreg() || writes[v.id] == 0;
+    };
+
+    map<int, InductionVariable> ivs;
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	if (!loop.body[b])
+	    continue;
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    IRInst& inst = code.insts[i];
+	    int d = defined_vreg(inst);
+	    if (d == -1 || writes[d] != 1 || !is_binary(inst.op))
+		continue;
+
+	    IRValue self = IRValue::vreg(d);
+	    if (inst.op == IR_ADD && inst.src1 == self && invariant(inst.src2))
+		ivs[d] = InductionVariable{i, inst.src2};
+	    else if (inst.op == IR_ADD && inst.src2 == self && invariant(inst.src1))
+		ivs[d] = InductionVariable{i, inst.src1};
+	    else if (inst.op == IR_SUB && inst.src1 == self && inst.src2.is_const())
+		ivs[d] = InductionVariable{i, IRValue::constant((short)-inst.src2.id)};
+	}
+    }
+
+    vector<IRInst> preheader;
+    map<pair<int, pair<int, int>>, IRValue> running; // i, k -> r
+    int reduced = 0;
+
+    for (int m : multiplies) {
+	IRInst& mul = code.insts[m];
+	IRValue i = mul.src1, k = mul.src2;
+	if (!(i.is_vreg() && ivs.count(i.id) && invariant(k)))
+	    swap(i, k);
+	if (!(i.is_vreg() && ivs.count(i.id) && invariant(k)))
+	    continue;
+
+	InductionVariable& iv = ivs[i.id];
+	auto key = make_pair(i.id, make_pair((int)k.kind, k.id));
+	if (running.count(key) == 0)
+	{
+	    IRValue r = code.new_vreg("iv");
+	    preheader.push_back(IRInst(IR_MUL, r, i, k));
+
+	    // how much r goes up every time i does
+	    IRValue step;
+	    if (iv.step.is_const() && k.is_const())
+		step = IRValue::constant((short)(iv.step.id * k.id));
+	    else if (iv.step == IRValue::constant(1))
+		step = k;
+	    else
+	    {
+		step = code.new_vreg("iv.step");
+		preheader.push_back(IRInst(IR_MUL, step, iv.step, k));
+	    }
+
+	    if (edits.count(iv.def) == 0)
+		edits[iv.def] = {code.insts[iv.def]};
+	    edits[iv.def].push_back(IRInst(IR_ADD, r, r, step));
+	    running[key] = r;
+	}
+
+	edits[m] = {IRInst(IR_LOAD, mul.dest, running[key])};
+	reduced++;
+    }
+
+    if (reduced)
+	preheaders.push_back(Preheader{&loop, preheader});
+    return reduced;
+}
+
+// removes the writes like v = v + c of vregs whose only reads are in
+// such writes. The other writes of them are left to eliminate_dead_code
+static int remove_dead_cycles(IRCode& code)
+{
+    vector<bool> read_elsewhere(code.num_vregs(), false);
+    vector<bool> written_impure(code.num_vregs(), false);
+    for (IRInst& inst : code.insts) {
+	int d = defined_vreg(inst);
+	if (d != -1 && !is_pure(inst.op))
+	    written_impure[d] = true;
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v.is_vreg() && v.id != d)
+		read_elsewhere[v.id] = true;
+	});
+    }
+
+    int removed = 0;
+    for (IRInst& inst : code.insts) {
+	int d = defined_vreg(inst);
+	if (d == -1 || read_elsewhere[d] || written_impure[d])
+	    continue;
+
+	bool reads_itself = false;
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v == IRValue::vreg(d))
+		reads_itself = true;
+	});
+	if (reads_itself)
+	{
+	    inst = IRInst(IR_NOP);
+	    removed++;
+	}
+    }
+    return removed;
+}
+
+int reduce_induction_variables(IRCode& code)
+{
+    code.compact();
+    if (code.insts.empty())
+	return 0;
+
+    int changed = remove_dead_cycles(code);
+    code.compact();
+
+    CFG cfg(code);
+    DominatorTree dom(cfg);
+    vector<Loop> loops = find_loops(cfg, dom);
+
+    // inner loops first, a multiply one of them reduced is left alone by
+    // the loops around it
+    map<int, vector<IRInst>> edits;
+    vector<Preheader> preheaders;
+    int reduced = 0;
+    for (Loop& loop : loops) {
+	if (can_add_preheader(code, cfg, loop))
+	    reduced += reduce_loop(code, cfg, loop, edits, preheaders);
+    }
+
+    if (reduced)
+	add_preheaders(code, cfg, preheaders, edits);
+    return changed + reduced;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Strength reduction of induction variables on the TACKY of one function.
+//
+// A basic induction variable of a loop is a vreg written only once in
+// it, by i = i + c or i = i - c with c not changing in the loop. A
+// derived one is t = i * k with k not changing in the loop. The multiply
+// is replaced with a running sum: a new vreg r = i * k is computed in a
+// preheader, r = r + c * k follows the write of i, and t = r takes the
+// place of the multiply, so the loop does an add where it did a multiply.
+//
+// Every loop is done in one call. Updates like i = i + c of a vreg that
+// nothing else reads, like an induction variable whose last use was the
+// multiply, are removed.
+//
+// Returns the number of multiplies and instructions removed.
+int reduce_induction_variables(IRCode& code);
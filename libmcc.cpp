@@ -0,0 +1,448 @@
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "libmcc.hpp"
+#include "assembler.hpp"
+#include "intrinsics.hpp"
+#include "asm.hpp"
+#include "peephole.hpp"
+#include "combine.hpp"
+#include "sccp.hpp"
+#include "gvn.hpp"
+#include "inline.hpp"
+#include "licm.hpp"
+#include "tailcalls.hpp"
+#include "ivs.hpp"
+#include "copies.hpp"
+#include "dce.hpp"
+#include "parser.hpp"
+#include "tokenizer.h"
+#include "mcc.hpp"
+
+using namespace std;
+
+// the pool nodes of the compilation running on this thread register with
+thread_local NodePool* active_pool = nullptr;
+
+NodePool::NodePool() : previous(active_pool)
+{
+    active_pool = this;
+}
+
+NodePool::~NodePool()
+{
+    active_pool = previous;
+
+    while (newest != nullptr) {
+	PoolNode* node = newest;
+	newest = node->older;
+	delete node;
+    }
+}
+
+PoolNode::PoolNode()
+{
+    if (active_pool != nullptr)
+    {
+	older = active_pool->newest;
+	active_pool->newest = this;
+    }
+}
+
+PoolNode::PoolNode(const PoolNode&) : PoolNode() {}
+
+// measures how long each phase of the pipeline takes
+class PhaseTimer
+{
+public:
+    vector<pair<string, double>>& phases;
+    chrono::steady_clock::time_point start_time;
+
+    PhaseTimer(vector<pair<string, double>>& _phases) : phases(_phases) {}
+
+    void begin()
+    {
+	start_time = chrono::steady_clock::now();
+    }
+
+    void end(string phase)
+    {
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start_time;
+	phases.push_back({phase, elapsed.count()});
+    }
+};
+
+ostream& operator<<(ostream& out, deque<token>& v)
+{
+    if (v.size() == 0)
+    {
+	out << "[]" << endl;
+	return out;
+    }
+
+    out << "[";
+    for (token t : v)
+    {
+	out
+	<< "(" << t.type
+	<< " : '" << t.val
+	<< "', start: " << t.start_index
+	<< ", end: " << t.end_index
+	<< ", line: " << t.line_number
+	<< ")" << ", " << endl;
+    }
+
+    out << "\b\b]";
+    return out;
+}
+
+// taken from https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
+string read_file(string filename)
+{
+    std::ifstream t(filename);
+    std::stringstream buffer;
+    buffer << t.rdbuf();
+
+    return buffer.str();
+}
+
+// taken from https://stackoverflow.com/questions/13172158/c-split-string-by-line
+vector<string> split_string_by_newline(string str)
+{
+    auto result = vector<string>{};
+    auto ss = stringstream{str};
+
+    for (string line; getline(ss, line, '\n');)
+        result.push_back(line);
+
+    return result;
+}
+
+// points at the offending code like this:
+//   Syntax Error, expected semicolon
+//   file.mc:3:12: 	return x
+//                 	        ^
+mcc::Diagnostic make_diagnostic(CompileError& error, vector<string>& lines_of_code, string file_name)
+{
+    // not about any particular line
+    if (error.line_number == 0)
+	return mcc::Diagnostic{error.heading, 0, 0, 0, error.heading + "\n"};
+
+    string line;
+    if (error.line_number >= 1 && error.line_number <= lines_of_code.size())
+	line = lines_of_code[error.line_number-1];
+
+    string location = file_name + ":" + to_string(error.line_number) + ":" + to_string(error.start) + ": ";
+
+    stringstream text;
+    text
+    << error.heading << endl
+    << location << line << endl
+    << string(location.length() + max(error.start, 0), ' ') << "^" << string(max(error.end - error.start - 1, 0), '~') << endl;
+
+    return mcc::Diagnostic{error.heading, error.line_number, error.start, error.end, text.str()};
+}
+
+mcc::Result mcc::compile(string_view source, const Options& options)
+{
+    Result result;
+    PhaseTimer timer(result.phase_times);
+    stringstream log;
+
+    // every node made by this compilation is freed when it returns
+    NodePool pool;
+    CompileContext context;
+
+    string code(source);
+    vector<string> lines_of_code = split_string_by_newline(code);
+
+    // diagnostics point into whatever is being read when they are raised
+    vector<string> error_lines = split_string_by_newline(options.opcode_table);
+    string error_file = "opcode table";
+
+    try {
+	OpcodeTable opcodes;
+	opcodes.load(options.opcode_table);
+
+	IntrinsicLibrary library_from_dir;
+	context.intrinsics = &IntrinsicLibrary::embedded();
+	if (!options.intrinsics_dir.empty())
+	{
+	    library_from_dir = IntrinsicLibrary::load(options.intrinsics_dir);
+	    context.intrinsics = &library_from_dir;
+	}
+
+	error_lines = lines_of_code;
+	error_file = options.file_name;
+
+	timer.begin();
+	deque<token> tokens = tokenize(code);
+	timer.end("tokenize");
+	//log << "Tok: " << tokens << endl;
+
+	timer.begin();
+	Program* p = parse(tokens);
+	timer.end("parse");
+	if (options.verbose)
+	{
+	    p->pretty_print(log);
+
+	    log << "---------------------------------------------------" << endl;
+	}
+
+	timer.begin();
+	map<string, identifier> var_map;
+	p->resolve_identifiers(var_map, context);
+	timer.end("resolve");
+
+	timer.begin();
+	p->label_loops("nil", context);
+	timer.end("label_loops");
+
+	timer.begin();
+	map<string, symbol> symbol_table;
+	p->do_type_checking(symbol_table);
+	timer.end("typecheck");
+
+	if (options.verbose)
+	{
+	    p->pretty_print(log);
+
+	    log << "---------------------------------------------------" << endl;
+	}
+
+	timer.begin();
+	IRBuilder tacky(context);
+	IRProgram* ir_prog = (IRProgram*)p->emit(tacky);
+	timer.end("tacky");
+
+	// a whole program starts at main, an object needs something to link
+	bool has_main = false;
+	for (IRFunction* f : ir_prog->functions)
+	    has_main |= f->name == "main";
+	if (ir_prog->functions.empty())
+	    throw CompileError("no functions are defined, there is nothing to compile", 0, 0, 0);
+	if (!options.emit_object && !has_main)
+	    throw CompileError("no main function is defined, there is nothing to run", 0, 0, 0);
+
+	// the optimization passes work on the dense encoding of each function
+	timer.begin();
+	vector<IRCode> codes;
+	for (IRFunction* f : ir_prog->functions)
+	    codes.push_back(f->encode());
+
+	int combined = 0, propagated = 0, eliminated = 0, constants = 0, common = 0, hoisted = 0, reduced = 0, tail = 0;
+	auto optimize = [&](IRCode& code) {
+	    // each pass opens up more work for the other
+	    int changed = 1;
+	    while (changed) {
+		int t = eliminate_tail_recursion(code);
+		int c = combine_instructions(code);
+		int k = propagate_constants(code);
+		int e = eliminate_common_subexpressions(code);
+		int h = hoist_loop_invariants(code);
+		int r = reduce_induction_variables(code);
+		int p = propagate_copies(code);
+		int d = eliminate_dead_code(code);
+		tail += t;
+		combined += c;
+		constants += k;
+		common += e;
+		hoisted += h;
+		reduced += r;
+		propagated += p;
+		eliminated += d;
+		changed = t + c + k + e + h + r + p + d;
+	    }
+	};
+
+	int inlined = 0, dropped = 0;
+	vector<bool> reachable(codes.size(), true);
+	if (options.optimize > 0)
+	{
+	    for (IRCode& code : codes)
+		optimize(code);
+
+	    // the callees are inlined as they are after optimizing, the callers are then optimized again
+	    bool whole_program = !options.emit_object;
+	    inlined = inline_functions(codes, whole_program);
+	    if (inlined)
+	    {
+		for (IRCode& code : codes)
+		    optimize(code);
+	    }
+
+	    // an object can be linked with code that calls anything in it
+	    if (whole_program)
+		reachable = reachable_functions(codes, "main");
+	}
+
+	vector<IRFunction*> kept;
+	for (int i = 0; i < codes.size(); i++) {
+	    if (!reachable[i])
+	    {
+		dropped++;
+		continue;
+	    }
+
+	    if (options.verbose)
+		codes[i].pretty_print(log);
+	    ir_prog->functions[i]->decode(codes[i]);
+	    kept.push_back(ir_prog->functions[i]);
+	}
+	ir_prog->functions = kept;
+	timer.end("ircode");
+
+	if (options.optimize > 0)
+	{
+	    result.statistics.push_back({"inline.calls", inlined});
+	    result.statistics.push_back({"inline.dropped", dropped});
+	    result.statistics.push_back({"tail.recursion", tail});
+	    result.statistics.push_back({"combine.simplified", combined});
+	    result.statistics.push_back({"sccp.replaced", constants});
+	    result.statistics.push_back({"cse.eliminated", common});
+	    result.statistics.push_back({"licm.hoisted", hoisted});
+	    result.statistics.push_back({"iv.reduced", reduced});
+	    result.statistics.push_back({"copies.propagated", propagated});
+	    result.statistics.push_back({"dce.removed", eliminated});
+	}
+
+	if (options.verbose)
+	{
+	    ir_prog->pretty_print(log);
+
+	    log << "---------------------------------------------------" << endl;
+	}
+
+	timer.begin();
+	vector<ASMNode*> assembly;
+	ir_prog->emit(assembly, context);
+	timer.end("codegen");
+
+	if (options.verbose)
+	{
+	    assembly[0]->pretty_print(log);
+
+	    log << "---------------------------------------------------" << endl;
+	}
+
+	timer.begin();
+	((ASMProgram*)assembly[0])->legalize();
+	timer.end("legalize");
+
+	if (options.verbose)
+	{
+	    assembly[0]->pretty_print(log);
+
+	    log << "---------------------------------------------------" << endl;
+	}
+
+	ASMProgram* asm_prog = (ASMProgram*)assembly[0];
+
+	timer.begin();
+	MachineCode functions;
+	asm_prog->emit_functions(functions);
+	timer.end("lower");
+
+	if (options.optimize > 0)
+	{
+	    timer.begin();
+	    result.statistics.push_back({"peephole.removed", peephole(functions)});
+	    timer.end("peephole");
+	}
+
+	MachineCode machine_code;
+	ASMProgram::emit_startup(machine_code);
+	machine_code.append(functions);
+	ASMProgram::emit_end(machine_code);
+
+	timer.begin();
+	stringstream output;
+	machine_code.print(output);
+	asm_prog->emit_intrinsics(output);
+	result.assembly = output.str();
+	timer.end("emit");
+
+	if (options.verbose)
+	    log << result.assembly;
+
+	if (options.emit_hex)
+	{
+	    error_lines = split_string_by_newline(result.assembly);
+	    error_file = options.file_name + " (assembly)";
+
+	    // the intrinsics become objects of their own, like mcc-ld does it
+	    timer.begin();
+	    // and are named like mcc-ld names them, for the link errors
+	    vector<ObjectFile> objects = {assemble_object(machine_code, opcodes, {}, true)};
+	    objects[0].name = options.file_name;
+	    for (string name : asm_prog->intrinsics_to_be_included()) {
+		const Intrinsic* intrinsic = context.intrinsics->find(name);
+		error_lines = split_string_by_newline(intrinsic->source);
+		error_file = name + ".s";
+		objects.push_back(assemble_object(parse_machine_code(intrinsic->source), opcodes, {name}, true));
+		objects.back().name = error_file;
+	    }
+	    result.image = link(objects);
+	    timer.end("assemble");
+	}
+
+	if (options.emit_object)
+	{
+	    // only the functions, mcc-ld adds the startup code and intrinsics
+	    stringstream functions_text;
+	    functions.print(functions_text);
+	    error_lines = split_string_by_newline(functions_text.str());
+	    error_file = options.file_name + " (assembly)";
+
+	    set<string> globals;
+	    for (ASMFunction* func : asm_prog->functions)
+		globals.insert(func->name);
+
+	    timer.begin();
+	    result.object = assemble_object(functions, opcodes, globals, true).serialize();
+	    timer.end("assemble");
+	}
+
+	result.success = true;
+    } catch (CompileError& error) {
+	result.diagnostics.push_back(make_diagnostic(error, error_lines, error_file));
+    } catch (exception& error) {
+	string message = string("internal compiler error: ") + error.what();
+	result.diagnostics.push_back(Diagnostic{message, 0, 0, 0, message + "\n"});
+    }
+
+    result.log = log.str();
+    return result;
+}
+
+mcc::Result mcc::assemble(string_view source, const Options& options)
+{
+    Result result;
+    PhaseTimer timer(result.phase_times);
+
+    string code(source);
+    vector<string> error_lines = split_string_by_newline(options.opcode_table);
+    string error_file = "opcode table";
+
+    try {
+	OpcodeTable opcodes;
+	opcodes.load(options.opcode_table);
+
+	error_lines = split_string_by_newline(code);
+	error_file = options.file_name;
+
+	timer.begin();
+	result.image = ::assemble(code, opcodes);
+	timer.end("assemble");
+
+	result.assembly = code;
+	result.success = true;
+    } catch (CompileError& error) {
+	result.diagnostics.push_back(make_diagnostic(error, error_lines, error_file));
+    }
+
+    return result;
+}
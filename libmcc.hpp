@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// embeddable interface to the compiler. Every call to compile() is
+// independent of the others, so a host can compile many programs in one
+// process and from several threads at once.
+namespace mcc
+{
+    class Options
+    {
+    public:
+	std::string file_name = "<input>";	// shown in diagnostics
+	bool verbose = false;			// dump each compiler pass into Result::log
+	bool emit_hex = false;			// also assemble into Result::image
+	bool emit_object = false;		// also assemble into Result::object, for mcc-ld
+	std::string opcode_table;		// extra encodings for the assembler, see assembler.hpp
+	std::string intrinsics_dir;		// use the .s files in here instead of the built in intrinsics
+	int optimize = 1;			// 0 turns the optimization passes off
+    };
+
+    class Diagnostic
+    {
+    public:
+	std::string message;	// e.g. "Syntax Error, expected semicolon"
+	int line_number;
+	int start;
+	int end;
+	std::string text;	// the message with the offending line underlined, as mcc prints it
+    };
+
+    class Result
+    {
+    public:
+	bool success = false;
+	std::string assembly;
+	std::vector<unsigned char> image;	// the memory image from 0x8000, when asked for
+	std::string object;			// relocatable object without startup code and intrinsics
+	std::vector<Diagnostic> diagnostics;
+	std::string log;
+	std::vector<std::pair<std::string, double>> phase_times;	// in milliseconds
+	std::vector<std::pair<std::string, int>> statistics;		// e.g. instructions removed by a pass
+    };
+
+    Result compile(std::string_view source, const Options& options = Options());
+
+    // assembles a program written in Mentat assembly, like the ones in
+    // asm_test, into Result::image. Only the opcode table of the options
+    // is used
+    Result assemble(std::string_view source, const Options& options = Options());
+}
@@ -0,0 +1,122 @@
+#include "licm.hpp"
+#include "dataflow.hpp"
+#include "loops.hpp"
+
+using namespace std;
+
+// the instructions of the loop that can be moved out, in the order they must run
+static vector<int> find_invariants(IRCode& code, CFG& cfg, DominatorTree& dom, DataflowResult& live, Loop& loop)
+{
+    vector<int> writes(code.num_vregs(), 0);
+    vector<int> exits;		// blocks of the loop with a successor outside it
+    for (int b = 0; b < cfg.blocks.size(); b++) {
+	if (!loop.body[b])
+	    continue;
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    int d = defined_vreg(code.insts[i]);
+	    if (d != -1)
+		writes[d]++;
+	}
+	for (int s : cfg.blocks[b].succs) {
+	    if (!loop.body[s])
+		exits.push_back(b);
+	}
+    }
+
+    vector<bool> invariant_vreg(code.num_vregs(), false);
+    vector<bool> hoisted(code.insts.size(), false);
+    vector<int> order;
+
+    auto invariant = [&](IRValue v) {
+	return !v.is_vreg() || writes[v.id] == 0 || invariant_vreg[v.id];
+    };
+
+    auto can_hoist = [&](int b, int i) {
+	IRInst& inst = code.insts[i];
+	if (hoisted[i] || !is_pure(inst.op))
+	    return false;
+	if ((inst.op == IR_DIV || inst.op == IR_MOD) && (!inst.src2.is_const() || (short)inst.src2.id == 0))
+	    return false;
+	if (!invariant(inst.src1) || (is_binary(inst.op) && !invariant(inst.src2)))
+	    return false;
+
+	int d = inst.dest.id;
+	if (writes[d] != 1 || live.in[loop.header].test(d))
+	    return false;
+
+	for (int exit : exits) {
+	    if (dom.dominates(b, exit))
+		continue;
+	    for (int s : cfg.blocks[exit].succs) {
+		if (!loop.body[s] && live.in[s].test(d))
+		    return false;
+	    }
+	}
+	return true;
+    };
+
+    bool changed = true;
+    while (changed) {
+	changed = false;
+	for (int b : dom.rpo) {
+	    if (!loop.body[b])
+		continue;
+	    for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+		if (can_hoist(b, i))
+		{
+		    hoisted[i] = true;
+		    invariant_vreg[code.insts[i].dest.id] = true;
+		    order.push_back(i);
+		    changed = true;
+		}
+	    }
+	}
+    }
+
+    return order;
+}
+
+int hoist_loop_invariants(IRCode& code)
+{
+    code.compact();
+    if (code.insts.empty())
+	return 0;
+
+    CFG cfg(code);
+    DominatorTree dom(cfg);
+    DataflowResult live = live_variables(code, cfg);
+    vector<Loop> loops = find_loops(cfg, dom);
+
+    // the loops come inner first, so an instruction ends up in the
+    // preheader of the outermost loop it can leave
+    vector<vector<int>> orders(loops.size());
+    map<int, int> leaves;	// instruction -> loop
+    for (int l = 0; l < loops.size(); l++) {
+	if (!can_add_preheader(code, cfg, loops[l]))
+	    continue;
+
+	orders[l] = find_invariants(code, cfg, dom, live, loops[l]);
+	for (int i : orders[l])
+	    leaves[i] = l;
+    }
+
+    vector<Preheader> preheaders;
+    map<int, vector<IRInst>> edits;
+    for (int l = 0; l < loops.size(); l++) {
+	Preheader preheader{&loops[l]};
+	for (int i : orders[l]) {
+	    if (leaves[i] != l)
+		continue;
+	    preheader.insts.push_back(code.insts[i]);
+	    edits[i] = {};
+	}
+	if (!preheader.insts.empty())
+	    preheaders.push_back(preheader);
+    }
+
+    if (edits.empty())
+	return 0;
+
+    add_preheaders(code, cfg, preheaders, edits);
+    return edits.size();
+}
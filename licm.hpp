@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Loop invariant code motion on the TACKY of one function.
+//
+// The natural loops are found from the back edges of the CFG, a jump to
+// a block that dominates it, so every loop the parser makes is found no
+// matter how it was written. A pure instruction is invariant if its
+// operands are not written in the loop, or only by other invariant
+// instructions. It is moved to a preheader, a new block in front of the
+// loop header that the jumps into the loop from outside go to, if:
+//
+//   - it is the only write of its dest in the loop
+//   - the dest is not live into the header, so no read in the loop sees
+//     an older value
+//   - the dest is not live after the loop, or the instruction runs on
+//     every way out of it
+//   - it can not fail, so no division unless by a constant other than 0
+//
+// Every loop is done in one call, an instruction invariant in nested
+// loops goes to the preheader of the outermost one it can leave.
+//
+// Returns the number of instructions hoisted.
+int hoist_loop_invariants(IRCode& code);
@@ -0,0 +1,118 @@
+#include "loops.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+vector<Loop> find_loops(CFG& cfg, DominatorTree& dom)
+{
+    int n = cfg.blocks.size();
+    vector<int> loop_of_header(n, -1);
+    vector<Loop> loops;
+
+    for (int tail : dom.rpo) {
+	for (int header : cfg.blocks[tail].succs) {
+	    if (!dom.dominates(header, tail))
+		continue;
+
+	    if (loop_of_header[header] == -1)
+	    {
+		loop_of_header[header] = loops.size();
+		loops.push_back(Loop{header, vector<bool>(n, false)});
+		loops.back().body[header] = true;
+		loops.back().size = 1;
+	    }
+	    Loop& loop = loops[loop_of_header[header]];
+
+	    // everything that reaches the tail without going through the header
+	    vector<int> worklist = {tail};
+	    while (!worklist.empty()) {
+		int b = worklist.back();
+		worklist.pop_back();
+		if (loop.body[b])
+		    continue;
+		loop.body[b] = true;
+		loop.size++;
+		for (int p : cfg.blocks[b].preds) {
+		    if (dom.reachable(p))
+			worklist.push_back(p);
+		}
+	    }
+	}
+    }
+
+    sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) {
+	return a.size < b.size;
+    });
+    return loops;
+}
+
+bool can_add_preheader(IRCode& code, CFG& cfg, Loop& loop)
+{
+    if (code.insts[cfg.blocks[loop.header].start].op != IR_LABEL)
+	return false;
+    if (loop.header == 0)
+	return true;
+
+    int above = loop.header - 1;
+    IROpcode last = code.insts[cfg.blocks[above].end].op;
+    return !loop.body[above] || last == IR_JUMP || last == IR_RETURN;
+}
+
+// a label name no other label has
+static IRValue new_label(IRCode& code, string base)
+{
+    string name = base;
+    for (int k = 1; code.label_ids.count(name); k++)
+	name = base + "." + to_string(k);
+    return code.label(name);
+}
+
+void add_preheaders(IRCode& code, CFG& cfg, vector<Preheader>& preheaders,
+		    map<int, vector<IRInst>>& edits)
+{
+    map<int, int> at_start;	// first instruction of a header -> its preheader
+    map<int, int> of_header;	// label of a header -> its preheader
+    vector<IRValue> labels;
+    for (int p = 0; p < preheaders.size(); p++) {
+	int start = cfg.blocks[preheaders[p].loop->header].start;
+	IRValue header_label = code.insts[start].dest;
+	at_start[start] = p;
+	of_header[header_label.id] = p;
+	labels.push_back(new_label(code, "pre_" + code.labels[header_label.id]));
+    }
+
+    vector<IRInst> insts;
+    for (int i = 0; i < code.insts.size(); i++) {
+	auto pre = at_start.find(i);
+	if (pre != at_start.end())
+	{
+	    insts.push_back(IRInst(IR_LABEL, labels[pre->second]));
+	    vector<IRInst>& body = preheaders[pre->second].insts;
+	    insts.insert(insts.end(), body.begin(), body.end());
+	}
+
+	auto edit = edits.find(i);
+	if (edit != edits.end())
+	{
+	    insts.insert(insts.end(), edit->second.begin(), edit->second.end());
+	    continue;
+	}
+
+	// the ways into a loop from outside now go through its preheader
+	IRInst inst = code.insts[i];
+	if (is_branch(inst.op))
+	{
+	    auto target = of_header.find(branch_target(inst).id);
+	    if (target != of_header.end() && !preheaders[target->second].loop->body[cfg.block_of[i]])
+	    {
+		if (inst.op == IR_JUMP)
+		    inst.src1 = labels[target->second];
+		else
+		    inst.src2 = labels[target->second];
+	    }
+	}
+	insts.push_back(inst);
+    }
+    code.insts = insts;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "cfg.hpp"
+
+#include <map>
+
+// Natural loops of the TACKY of one function, and preheaders for them.
+
+class Loop
+{
+public:
+    int header;
+    vector<bool> body;		// of every block
+    int size = 0;
+};
+
+// the natural loops, from the back edges of the CFG (a jump to a block
+// that dominates it). One per header, smallest first, so inner loops
+// come before the loops around them
+vector<Loop> find_loops(CFG& cfg, DominatorTree& dom);
+
+// true if a preheader can be put in front of the loop: the header starts
+// with a label and nothing in the loop falls through into it
+bool can_add_preheader(IRCode& code, CFG& cfg, Loop& loop);
+
+// instructions to put in a new block right before the header of a loop
+class Preheader
+{
+public:
+    Loop* loop;
+    vector<IRInst> insts;
+};
+
+// rebuilds the code with every preheader in front of its loop, and the
+// jumps into each loop from outside going to its preheader. edits[i], if
+// there is one, takes the place of instruction i. The loops must have
+// different headers
+void add_preheaders(IRCode& code, CFG& cfg, vector<Preheader>& preheaders,
+		    map<int, vector<IRInst>>& edits);
+
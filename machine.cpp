@@ -0,0 +1,116 @@
+#include "machine.hpp"
+
+#include <iomanip>
+
+using namespace std;
+
+MOperand MOperand::reg(int r)
+{
+    return MOperand{MOP_REG, r, ""};
+}
+
+MOperand MOperand::imm(int value)
+{
+    return MOperand{MOP_IMM, value, ""};
+}
+
+MOperand MOperand::label_ref(string name)
+{
+    return MOperand{MOP_LABEL, 0, name};
+}
+
+bool MOperand::operator==(const MOperand& other) const
+{
+    return kind == other.kind && value == other.value && label == other.label;
+}
+
+string MOperand::to_string() const
+{
+    switch (kind)
+    {
+    case MOP_REG:
+	return "%r" + std::to_string(value);
+    case MOP_IMM:
+	return std::to_string(value);
+    case MOP_LABEL:
+	return label;
+    }
+    return "";
+}
+
+void MInstr::print(ostream& out) const
+{
+    switch (kind)
+    {
+    case MI_INSTR:
+    {
+	string text = name;
+	for (const MOperand& operand : operands)
+	    text += " " + operand.to_string();
+
+	if (comment.empty())
+	    out << "\t" << text << endl;
+	else
+	    out << left << "\t" << setw(20) << text << " ; " << comment << endl;
+	break;
+    }
+    case MI_LABEL:
+	out << name << ":" << endl;
+	break;
+    case MI_COMMENT:
+	out << "\t;; " << name << endl;
+	break;
+    case MI_BLANK:
+	out << endl;
+	break;
+    }
+}
+
+void MachineCode::push(MInstr instr)
+{
+    instrs.push_back(instr);
+    instrs.back().line_number = instrs.size();
+}
+
+void MachineCode::op(string mnemonic, string comment)
+{
+    push(MInstr(MI_INSTR, mnemonic, {}, comment));
+}
+
+void MachineCode::op(string mnemonic, MOperand operand, string comment)
+{
+    push(MInstr(MI_INSTR, mnemonic, {operand}, comment));
+}
+
+void MachineCode::label(string name)
+{
+    push(MInstr(MI_LABEL, name));
+}
+
+void MachineCode::comment(string text)
+{
+    push(MInstr(MI_COMMENT, text));
+}
+
+void MachineCode::blank()
+{
+    push(MInstr(MI_BLANK));
+}
+
+void MachineCode::append(const MachineCode& other)
+{
+    for (const MInstr& instr : other.instrs)
+	push(instr);
+}
+
+void MachineCode::renumber()
+{
+    for (int i = 0; i < instrs.size(); i++)
+	instrs[i].line_number = i + 1;
+}
+
+void MachineCode::print(ostream& out) const
+{
+    for (const MInstr& instr : instrs)
+	instr.print(out);
+}
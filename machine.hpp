@@ -0,0 +1,98 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Mentat machine code, one record per real instruction.
+//
+// The ASM nodes are lowered to this, then the text writer prints it and
+// the encoder in assembler.cpp turns it into words. Passes that run on
+// it see exactly what the hardware executes. Labels, comments and blank
+// lines are records of their own, so that the text output stays readable.
+
+enum MOperandKind
+{
+    MOP_REG,			// %r3
+    MOP_IMM,			// 5
+    MOP_LABEL			// main
+};
+
+class MOperand
+{
+public:
+    MOperandKind kind;
+    int value;			// register number or immediate
+    string label;
+
+    static MOperand reg(int r);
+    static MOperand imm(int value);
+    static MOperand label_ref(string name);
+
+    bool operator==(const MOperand& other) const;
+
+    string to_string() const;
+};
+
+enum MInstrKind
+{
+    MI_INSTR,
+    MI_LABEL,
+    MI_COMMENT,
+    MI_BLANK
+};
+
+class MInstr
+{
+public:
+    MInstrKind kind;
+    string name;		// mnemonic, label or comment text
+    vector<MOperand> operands;
+    string comment;		// trailing comment of an instruction
+    int line_number;		// where it is in the text, for errors
+    int length;
+
+    MInstr(MInstrKind _kind = MI_INSTR, string _name = "", vector<MOperand> _operands = {}, string _comment = "")
+	:
+	kind(_kind),
+	name(_name),
+	operands(_operands),
+	comment(_comment),
+	line_number(0),
+	length(0)
+    {}
+
+    bool is_instruction() const
+    {
+	return kind == MI_INSTR;
+    }
+
+    void print(ostream& out) const;
+};
+
+// the machine code of a program or a part of one. Every record prints as
+// one line, so the line number of a record is its index + 1
+class MachineCode
+{
+public:
+    vector<MInstr> instrs;
+
+    void op(string mnemonic, string comment = "");
+    void op(string mnemonic, MOperand operand, string comment = "");
+
+    void label(string name);
+    void comment(string text);
+    void blank();
+
+    void append(const MachineCode& other);
+
+    void print(ostream& out) const;
+
+    // sets the line numbers again after records were removed
+    void renumber();
+
+private:
+    void push(MInstr instr);
+};
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "assembler.hpp"
+#include "intrinsics.hpp"
+#include "asm.hpp"
+#include "object.hpp"
+#include "CLI11.hpp"
+#include "mcc.hpp"
+
+using namespace std;
+
+// mcc-ld - links objects made by mcc -c into a memory image
+//
+// The image is laid out like the one mcc --emit=hex makes for a single
+// file: startup code, the objects in command line order, the final halt,
+// then every intrinsic the program needs (sorted by name).
+
+ObjectFile assemble_named(const MachineCode& code, string name, OpcodeTable& table, set<string> globals)
+{
+    ObjectFile obj = assemble_object(code, table, globals, true);
+    obj.name = name;
+    return obj;
+}
+
+// the intrinsics that provide the undefined symbols, and the ones they need in turn
+vector<ObjectFile> find_intrinsics(vector<ObjectFile>& objects, const IntrinsicLibrary& library, OpcodeTable& table)
+{
+    set<string> defined;
+    vector<string> wanted;
+    for (ObjectFile& obj : objects) {
+	for (ObjectSymbol& sym : obj.symbols) {
+	    if (sym.defined && sym.global)
+		defined.insert(sym.name);
+	}
+	for (string name : obj.undefined_symbols())
+	    wanted.push_back(name);
+    }
+
+    vector<ObjectFile> result;
+    while (!wanted.empty()) {
+	string name = wanted.back();
+	wanted.pop_back();
+	if (defined.count(name))
+	    continue;
+	defined.insert(name);
+
+	// missing ones are reported as undefined by the linker
+	const Intrinsic* source = library.find(name);
+	if (source == nullptr)
+	    continue;
+
+	ObjectFile intrinsic = assemble_named(parse_machine_code(source->source), name + ".s", table, {name});
+	for (string dependency : intrinsic.undefined_symbols())
+	    wanted.push_back(dependency);
+	result.push_back(intrinsic);
+    }
+
+    sort(result.begin(), result.end(), [](ObjectFile& a, ObjectFile& b) { return a.name < b.name; });
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    vector<string> infiles;
+    string outfile;
+    string opcodes_file;
+    string intrinsics_dir;
+
+    CLI::App app{"mcc-ld - links objects made by mcc -c into a Mentat memory image"};
+    app.add_option("inputs", infiles, "The object files")->required();
+    app.add_option("-o,--output", outfile, "The output hex file")->required();
+    app.add_option("--opcodes", opcodes_file, "Table of extra instruction encodings");
+    app.add_option("--intrinsics-dir", intrinsics_dir, "Use the intrinsic functions in this directory instead of the built in ones");
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+	OpcodeTable table;
+	if (!opcodes_file.empty())
+	    table.load(read_file(opcodes_file));
+
+	MachineCode startup, end;
+	ASMProgram::emit_startup(startup);
+	ASMProgram::emit_end(end);
+
+	vector<ObjectFile> objects;
+	objects.push_back(assemble_named(startup, "startup code", table, {}));
+	for (string infile : infiles)
+	    objects.push_back(ObjectFile::deserialize(read_file(infile), infile));
+	objects.push_back(assemble_named(end, "startup code", table, {}));
+
+	IntrinsicLibrary library_from_dir;
+	const IntrinsicLibrary* library = &IntrinsicLibrary::embedded();
+	if (!intrinsics_dir.empty())
+	{
+	    library_from_dir = IntrinsicLibrary::load(intrinsics_dir);
+	    library = &library_from_dir;
+	}
+
+	for (ObjectFile& intrinsic : find_intrinsics(objects, *library, table))
+	    objects.push_back(intrinsic);
+
+	vector<unsigned char> image = link(objects);
+
+	ofstream output_file(outfile, ios::trunc | ios::binary);
+	output_file.write((const char*)image.data(), image.size());
+    } catch (CompileError& error) {
+	cerr << "mcc-ld: " << error.heading;
+	if (error.line_number > 0)
+	    cerr << " (line " << error.line_number << ")";
+	cerr << endl;
+	return 1;
+    }
+}
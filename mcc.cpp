@@ -1,157 +1,104 @@
 #include <iostream>
+#include <iomanip>
+#include <fstream>
 #include <string>
-#include <unordered_map>
+#include <chrono>
 
-#include "asm.hpp"
-#include "parser.hpp"
-#include "tokenizer.h"
+#include "libmcc.hpp"
 #include "CLI11.hpp"
 #include "mcc.hpp"
 
 using namespace std;
 
-vector<string> lines_of_code;
-string code;
-string infile;
-string outfile;
-bool pretty_print = false;
-
-CodeContext get_code_context(token tok, int number_of_lines)
-{
-    return CodeContext(tok.line_number, lines_of_code[tok.line_number-1]);
-}
-
-string get_line_of_code(int line)
-{
-    return lines_of_code[line-1];
-}
-
-string file_name()
-{
-    return infile;
-}
-
-ostream& operator<<(ostream& out, deque<token>& v)
-{
-    if (v.size() == 0)
-    {
-	out << "[]" << endl;
-	return out;
-    }
-
-    out << "[";
-    for (token t : v)
-    {
-	out
-	<< "(" << t.type
-	<< " : '" << t.val
-	<< "', start: " << t.start_index
-	<< ", end: " << t.end_index
-	<< ", line: " << t.line_number
-	<< ")" << ", " << endl;
-    }
-
-    out << "\b\b]";
-    return out;
-}
-
-// taken from https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
-string read_file(string filename)
+void report_phase(ostream& out, string phase, double ms)
 {
-    std::ifstream t(filename);
-    std::stringstream buffer;
-    buffer << t.rdbuf();
-
-    return buffer.str();
-}
-
-// taken from https://stackoverflow.com/questions/13172158/c-split-string-by-line
-vector<string> split_string_by_newline(string str)
-{
-    auto result = vector<string>{};
-    auto ss = stringstream{str};
-
-    for (string line; getline(ss, line, '\n');)
-        result.push_back(line);
-
-    return result;
+    out << "phase " << left << setw(12) << phase << " " << fixed << setprecision(4) << ms << " ms" << endl;
 }
 
 int main(int argc, char** argv)
 {
+    string infile;
+    string outfile;
+    bool pretty_print = false;
+    bool time_passes = false;
+    string emit = "asm";
+    string opcodes_file;
+    bool object = false;
+    string intrinsics_dir;
+    int optimize = 1;
+    bool statistics = false;
+
     CLI::App app{"mcc - a small simple C compiler for the Mentat PCB computer"};
-    app.add_option("-i,--input", infile, "The file to be compiled");
+    app.add_option("-i,--input", infile, "The file to be compiled, a .s file is assembled into a memory image");
     app.add_option("-o,--output", outfile, "The output asm file");
     app.add_flag("-v,--verbose",  pretty_print, "Print each compiler pass");
+    app.add_flag("-t,--time-passes", time_passes, "Print the time taken by each compiler phase");
+    app.add_option("--emit", emit, "Output assembly text (asm) or a memory image (hex)")->check(CLI::IsMember({"asm", "hex"}));
+    app.add_option("--opcodes", opcodes_file, "Table of extra instruction encodings for --emit=hex and -c");
+    app.add_flag("-c", object, "Output a relocatable object for mcc-ld");
+    app.add_option("--intrinsics-dir", intrinsics_dir, "Use the intrinsic functions in this directory instead of the built in ones");
+    app.add_option("-O,--optimize", optimize, "Optimization level, 0 turns the optimizations off");
+    app.add_flag("-s,--statistics", statistics, "Print what the optimization passes did");
     CLI11_PARSE(app, argc, argv);
 
-    code = read_file(infile);
-    lines_of_code = split_string_by_newline(code);
-    
-    
-    deque<token> tokens = tokenize(code);
-    //cout << "Tok: " << tokens << endl;
-
-    Program* p = parse(tokens);
-    if (pretty_print)
+    auto start_time = chrono::steady_clock::now();
+    string code = read_file(infile);
+    chrono::duration<double, milli> read_time = chrono::steady_clock::now() - start_time;
+
+    mcc::Options options;
+    options.file_name = infile;
+    options.verbose = pretty_print;
+    options.emit_hex = emit == "hex" && !object;
+    options.emit_object = object;
+    options.intrinsics_dir = intrinsics_dir;
+    options.optimize = optimize;
+    if (!opcodes_file.empty())
+	options.opcode_table = read_file(opcodes_file);
+
+    // assembly is only assembled, as the asm_test programs are
+    bool assembly_input = infile.size() > 2 && infile.substr(infile.size() - 2) == ".s";
+    if (assembly_input)
     {
-	p->pretty_print(cout);
-
-	cout << "---------------------------------------------------" << endl;
+	options.emit_hex = true;
+	options.emit_object = false;
     }
 
-    map<string, identifier> var_map;
-    p->resolve_identifiers(var_map);
+    mcc::Result result = assembly_input ? mcc::assemble(code, options) : mcc::compile(code, options);
 
-    p->label_loops("nil");
+    cout << result.log;
+    for (mcc::Diagnostic& diagnostic : result.diagnostics)
+	cout << diagnostic.text;
 
-    map<string, symbol> symbol_table;
-    p->do_type_checking(symbol_table);
+    if (!result.success)
+	return -1;
 
-    if (pretty_print)
+    // write to the file
+    if (options.emit_object)
     {
-	p->pretty_print(cout);
-    
-	cout << "---------------------------------------------------" << endl;
+	ofstream output_file(outfile, ios::trunc | ios::binary);
+	output_file << result.object;
     }
-    
-    vector<IRNode*> tacky;
-    IRProgram* ir_prog = (IRProgram*)p->emit(tacky);
-
-    if (pretty_print)
+    else if (options.emit_hex)
     {
-	ir_prog->pretty_print(cout);
-
-	cout << "---------------------------------------------------" << endl;
+	ofstream output_file(outfile, ios::trunc | ios::binary);
+	output_file.write((const char*)result.image.data(), result.image.size());
     }
-    
-    vector<ASMNode*> assembly;
-    ir_prog->emit(assembly);
-
-    if (pretty_print)
+    else
     {
-	assembly[0]->pretty_print(cout);
-
-	cout << "---------------------------------------------------" << endl;
+	ofstream output_file(outfile, ios::trunc);
+	output_file << result.assembly;
     }
-    
-    unordered_map<string, int> temps;
-    ((ASMProgram*)assembly[0])->legalize(temps);
 
-    if (pretty_print)
+    if (time_passes)
     {
-	assembly[0]->pretty_print(cout);
-
-	cout << "---------------------------------------------------" << endl;
+	report_phase(cerr, "read", read_time.count());
+	for (auto& p : result.phase_times)
+	    report_phase(cerr, p.first, p.second);
     }
-    
-    if (pretty_print)
-	assembly[0]->emit(cout);
 
-    // write to the file
-
-    ofstream output_file(outfile, ios::trunc);
-    assembly[0]->emit(output_file);
-    output_file.close();
-    
+    if (statistics)
+    {
+	for (auto& s : result.statistics)
+	    cerr << "stat " << left << setw(24) << s.first << " " << s.second << endl;
+    }
 }
@@ -1,23 +1,83 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "tokenizer.h"
 
-class CodeContext
+// raised by any phase when the input cannot be compiled, the library
+// turns it into a diagnostic instead of exiting
+class CompileError
 {
 public:
+    string heading;		// e.g. "Syntax Error, expected semicolon"
     int line_number;
-    string context;
-    CodeContext(int _l,
-		string _cxt)
-	    :
-		line_number(_l),
-		context(_cxt)
+    int start;
+    int end;
+
+    CompileError(string _heading, int _line_number, int _start, int _end)
+	:
+	heading(_heading),
+	line_number(_line_number),
+	start(_start),
+	end(_end)
     {}
 };
 
-CodeContext get_code_context(token tok, int number_of_lines=1);
-string get_line_of_code(int);
-string file_name();
+// state that has to be unique within one compilation, threaded through
+// the passes so that independent compilations do not share anything
+class IntrinsicLibrary;
+
+class CompileContext
+{
+public:
+    const IntrinsicLibrary* intrinsics = nullptr;
+    int label_count = 0;	// used to generate unique labels
+    int variable_count = 0;	// used to generate unique variable names
+    int loop_count = 0;		// used to generate unique loop labels
+
+    string uniq_label()
+    {
+	return "label" + to_string(label_count++);
+    }
+
+    string uniq_var_name(string orig_name)
+    {
+	return orig_name + "." + to_string(variable_count++);
+    }
+
+    string uniq_loop_label(string orig_name)
+    {
+	return orig_name + "." + to_string(loop_count++);
+    }
+};
+
+class PoolNode;
+
+// owns every AST, IR and ASM node created while it is active, so a
+// compilation frees all of its nodes at once when it is done
+class NodePool
+{
+public:
+    PoolNode* newest = nullptr;	// the nodes are linked newest first
+    NodePool* previous;
+
+    NodePool();
+    ~NodePool();
+};
+
+// base of every heap allocated compiler node, registers itself with the
+// active NodePool of the current thread
+class PoolNode
+{
+public:
+    PoolNode();
+    PoolNode(const PoolNode&);
+    virtual ~PoolNode() {}
+
+    // a copy joins the pool on its own, it does not take the link
+    PoolNode& operator=(const PoolNode&) { return *this; }
+
+    PoolNode* older = nullptr;	// the node created before this one
+};
 
 string read_file(string filename);
@@ -0,0 +1,200 @@
+#include "object.hpp"
+#include "assembler.hpp"
+
+#include <map>
+
+using namespace std;
+
+// the object file starts with this, followed by big endian fields:
+//   code:        word count, words
+//   symbols:     count, then flags byte, offset word, name length byte, name
+//   relocations: count, then offset word, symbol word
+#define OBJECT_MAGIC "MCO1"
+
+#define SYMBOL_DEFINED 1
+#define SYMBOL_GLOBAL 2
+
+bool ObjectFile::define(string name, int offset, bool global)
+{
+    ObjectSymbol& sym = symbols[symbol(name)];
+    if (sym.defined)
+	return false;
+
+    sym = ObjectSymbol(name, offset, true, global);
+    return true;
+}
+
+int ObjectFile::symbol(string name)
+{
+    auto it = symbol_ids.find(name);
+    if (it != symbol_ids.end())
+	return it->second;
+
+    // anything referenced without being defined must come from another object
+    symbols.push_back(ObjectSymbol(name, 0, false, true));
+    symbol_ids[name] = symbols.size() - 1;
+    return symbols.size() - 1;
+}
+
+vector<string> ObjectFile::undefined_symbols()
+{
+    vector<string> result;
+    for (ObjectSymbol& sym : symbols) {
+	if (!sym.defined)
+	    result.push_back(sym.name);
+    }
+    return result;
+}
+
+void put_word(string& out, int word)
+{
+    out += (char)((word >> 8) & 0xff);
+    out += (char)(word & 0xff);
+}
+
+string ObjectFile::serialize()
+{
+    string out = OBJECT_MAGIC;
+
+    put_word(out, code.size());
+    for (unsigned short word : code)
+	put_word(out, word);
+
+    put_word(out, symbols.size());
+    for (ObjectSymbol& sym : symbols) {
+	if (sym.name.size() > 0xff)
+	    throw CompileError("symbol name too long for an object file: " + sym.name, 0, 0, 0);
+	out += (char)((sym.defined ? SYMBOL_DEFINED : 0) | (sym.global ? SYMBOL_GLOBAL : 0));
+	put_word(out, sym.offset);
+	out += (char)sym.name.size();
+	out += sym.name;
+    }
+
+    put_word(out, relocations.size());
+    for (Relocation& reloc : relocations) {
+	put_word(out, reloc.offset);
+	put_word(out, reloc.symbol);
+    }
+
+    return out;
+}
+
+// reads the fields written by serialize(), failing on truncated data
+class ObjectReader
+{
+public:
+    string& data;
+    string name;
+    int pos;
+
+    ObjectReader(string& _data, string _name) : data(_data), name(_name), pos(0) {}
+
+    void need(int bytes)
+    {
+	if (pos + bytes > data.size())
+	    throw CompileError(name + ": truncated object file", 0, 0, 0);
+    }
+
+    int byte()
+    {
+	need(1);
+	return (unsigned char)data[pos++];
+    }
+
+    int word()
+    {
+	int high = byte();
+	return high << 8 | byte();
+    }
+
+    string text(int length)
+    {
+	need(length);
+	pos += length;
+	return data.substr(pos - length, length);
+    }
+};
+
+ObjectFile ObjectFile::deserialize(string data, string name)
+{
+    ObjectReader in(data, name);
+    if (data.compare(0, 4, OBJECT_MAGIC) != 0)
+	throw CompileError(name + ": not an mcc object file", 0, 0, 0);
+    in.pos = 4;
+
+    ObjectFile result;
+    result.name = name;
+
+    int code_size = in.word();
+    for (int i=0;i<code_size;i++)
+	result.code.push_back(in.word());
+
+    int symbol_count = in.word();
+    for (int i=0;i<symbol_count;i++) {
+	int flags = in.byte();
+	int offset = in.word();
+	string sym_name = in.text(in.byte());
+	result.symbols.push_back(ObjectSymbol(sym_name, offset, flags & SYMBOL_DEFINED, flags & SYMBOL_GLOBAL));
+	result.symbol_ids[sym_name] = i;
+    }
+
+    int reloc_count = in.word();
+    for (int i=0;i<reloc_count;i++) {
+	int offset = in.word();
+	int symbol = in.word();
+	if (offset >= code_size || symbol >= symbol_count)
+	    throw CompileError(name + ": corrupt relocation", 0, 0, 0);
+	result.relocations.push_back(Relocation(offset, symbol));
+    }
+
+    return result;
+}
+
+vector<unsigned char> link(vector<ObjectFile>& objects)
+{
+    // place the objects and collect the global symbols
+    vector<int> bases;
+    map<string, int> globals;
+    int address = IMAGE_ORIGIN;
+    for (ObjectFile& obj : objects) {
+	bases.push_back(address);
+
+	for (ObjectSymbol& sym : obj.symbols) {
+	    if (!sym.defined || !sym.global)
+		continue;
+	    if (globals.count(sym.name))
+		throw CompileError("multiple definition of " + sym.name + " in " + obj.name, 0, 0, 0);
+	    globals[sym.name] = address + sym.offset;
+	}
+
+	address += obj.code.size();
+	if (address > 0x10000)
+	    throw CompileError("program does not fit in memory", 0, 0, 0);
+    }
+
+    vector<unsigned char> image;
+    for (int i=0;i<objects.size();i++) {
+	ObjectFile& obj = objects[i];
+	vector<unsigned short> code = obj.code;
+
+	for (Relocation& reloc : obj.relocations) {
+	    ObjectSymbol& sym = obj.symbols[reloc.symbol];
+	    if (sym.defined) {
+		code[reloc.offset] = bases[i] + sym.offset;
+		continue;
+	    }
+
+	    auto it = globals.find(sym.name);
+	    if (it == globals.end())
+		throw CompileError("undefined reference to " + sym.name + " in " + obj.name, 0, 0, 0);
+	    code[reloc.offset] = it->second;
+	}
+
+	for (unsigned short word : code) {
+	    image.push_back(word >> 8);
+	    image.push_back(word & 0xff);
+	}
+    }
+
+    return image;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mcc.hpp"
+
+using namespace std;
+
+// Relocatable objects made by mcc -c and linked by mcc-ld.
+//
+// An object is position independent machine code plus the symbols it
+// defines or needs. Every address operand is a relocation against a
+// symbol, so the linker can place objects anywhere in the image. Local
+// symbols (compiler generated labels) are only visible inside their
+// object, global ones (functions) are visible to every object.
+
+class ObjectSymbol
+{
+public:
+    string name;
+    int offset;			// in words from the start of the object
+    bool defined;
+    bool global;
+
+    ObjectSymbol(string _name = "", int _offset = 0, bool _defined = false, bool _global = false)
+	:
+	name(_name),
+	offset(_offset),
+	defined(_defined),
+	global(_global)
+    {}
+};
+
+// the word at offset gets the address of symbols[symbol]
+class Relocation
+{
+public:
+    int offset;
+    int symbol;
+
+    Relocation(int _offset = 0, int _symbol = 0) : offset(_offset), symbol(_symbol) {}
+};
+
+class ObjectFile
+{
+public:
+    string name;		// for error messages
+    vector<unsigned short> code;
+    vector<ObjectSymbol> symbols;
+    vector<Relocation> relocations;
+    map<string, int> symbol_ids;	// name -> index into symbols
+
+    // define a symbol at offset, false if it already was
+    bool define(string name, int offset, bool global);
+
+    // index of the symbol, undefined symbols are added on first use
+    int symbol(string name);
+
+    // names of the global symbols used but not defined here
+    vector<string> undefined_symbols();
+
+    string serialize();
+
+    // throws CompileError if data is not an object made by serialize()
+    static ObjectFile deserialize(string data, string name);
+};
+
+// lays the objects out one after the other from the start of memory and
+// patches every relocation, throws CompileError for undefined and
+// duplicate global symbols
+vector<unsigned char> link(vector<ObjectFile>& objects);
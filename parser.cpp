@@ -13,12 +13,7 @@
 ostream& operator<<(ostream& out, deque<token>& v);
 
 
-int counter = 0;		// used to generate unique temp variables
-int label_count = 0;		// used to generate unique labels
-int variable_count = 0;		// used to generate unique variable names
-int loop_count = 0;		// used to generate unique loop labels
-
-map<string, int> precedence = {
+const map<string, int> precedence = {
     {"+"	, 45},
     {"-"	, 45},
     {"%"	, 50},
@@ -36,28 +31,13 @@ map<string, int> precedence = {
     {"="	,  1},
 };
 
-IRVar* temp_var()
+// operators without an entry bind like the lowest precedence
+int get_precedence(string op)
 {
-    string result = "tmp" + to_string(counter);
-    counter++;
-    return new IRVar(result);
-}
-
-string uniq_label()
-{
-    string result = "label" + to_string(label_count);
-    label_count++;
-    return result;
-}
-
-string uniq_var_name(string orig_name)
-{
-    return orig_name + "." + to_string(variable_count++);
-}
-
-string uniq_loop_label(string orig_name)
-{
-    return orig_name + "." + to_string(loop_count++);
+    auto it = precedence.find(op);
+    if (it == precedence.end())
+	return 0;
+    return it->second;
 }
 
 void copy_ident_map(map<string, identifier>& dest, map<string, identifier> src)
@@ -69,24 +49,21 @@ void copy_ident_map(map<string, identifier>& dest, map<string, identifier> src)
 
 
 
+// the last token is always the end of file marker added by parse(),
+// it is never removed so that running out of input is a syntax error
 inline token pop(deque<token>& tok)
 {
     token result = tok.front();
+    if (tok.size() == 1)
+	return result;
+
     tok.pop_front();
     return result;
 }
 
 inline void fail(token t, string expectation = "")
 {
-    CodeContext cxt = get_code_context(t);
-    string location = file_name() + ":" + to_string(t.line_number) + ":" + to_string(t.start_index) + ": ";
-    
-    cout << "Syntax Error, expected " << expectation << endl
-    << location << cxt.context << endl
-    << string(t.start_index + location.length(), ' ') << "^" << string(t.end_index - t.start_index - 1, '~') << endl;
-    
-    
-    exit(-1);
+    throw CompileError("Syntax Error, expected " + expectation, t.line_number, t.start_index, t.end_index);
 }
 
 // pop a token and check its type
@@ -126,7 +103,7 @@ Declaration* parse_declaration(deque<token>& toks, bool allow_function_definion
 
 Declaration* parse_declaration(deque<token>& toks, bool allow_function_definiton)
 {
-    if (toks[2].val == "(") 	// its a function declaration
+    if (toks.size() > 2 && toks[2].val == "(") 	// its a function declaration
     {
 	return parse_function_declaration(toks, allow_function_definiton);
     }
@@ -478,13 +455,13 @@ Expression* parse_expression(deque<token>& toks, int min_precedence)
     Expression* left = parse_factor(toks);
     token next = toks.front();
     
-    while (next.type & (BINARY | TERNARY | UNARY) && precedence[next.val] >= min_precedence)
+    while (next.type & (BINARY | TERNARY | UNARY) && get_precedence(next.val) >= min_precedence)
     {
 	toks.pop_front();
 	
 	if (next.val == "=")	// check if its assignment, we want right associative
 	{
-	    Expression* right = parse_expression(toks, precedence[next.val]);
+	    Expression* right = parse_expression(toks, get_precedence(next.val));
 	    end_debug();
 	    left = new Assignment(left, right, debug);
 	}
@@ -499,7 +476,7 @@ Expression* parse_expression(deque<token>& toks, int min_precedence)
 
 	    check_val(toks, ":", ": for ternary operator");
 	    
-	    Expression* false_val = parse_expression(toks, precedence[next.val]);
+	    Expression* false_val = parse_expression(toks, get_precedence(next.val));
 
 	    end_debug();
 	    
@@ -508,7 +485,7 @@ Expression* parse_expression(deque<token>& toks, int min_precedence)
 	else			// else we want left associative
 	{
 	    string op = next.val;
-	    Expression* right = parse_expression(toks, precedence[op] + 1);
+	    Expression* right = parse_expression(toks, get_precedence(op) + 1);
 
 	    end_debug();
 	    
@@ -530,7 +507,13 @@ Expression* parse_factor(deque<token>& toks)
     if (tok.type & NUMBER)
     {
 	end_debug();
-	return new Constant(stoi(tok.val), debug);
+	int value = 0;
+	try {
+	    value = stoi(tok.val);
+	} catch (out_of_range&) {
+	    fail(tok, "integer constant that fits in an int");
+	}
+	return new Constant(value, debug);
     }
     else if (tok.type & UNARY)
     {
@@ -590,10 +573,15 @@ Expression* parse_factor(deque<token>& toks)
 
 Program* parse(deque<token>& toks)
 {
+    // end of file marker, it matches no token type or value
+    int last_line = toks.empty() ? 1 : toks.back().line_number;
+    int last_end = toks.empty() ? 0 : toks.back().end_index;
+    toks.push_back(token((token_type)0, "", last_end, last_end + 1, last_line));
+
     start_debug();
 
     vector<Declaration*> functions;
-    while(toks.size() > 0)
+    while(toks.size() > 1)
     {
 	Declaration* curr_decl = parse_declaration(toks, true);
 	functions.push_back(curr_decl);
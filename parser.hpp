@@ -17,11 +17,6 @@
 
 using namespace std;
 
-IRVar* temp_var();
-string uniq_label();
-string uniq_var_name(string);
-string uniq_loop_label(string orig);
-
 enum ASTType{
     FUNC,
     FUNCTION_CALL,
@@ -52,7 +47,7 @@ enum ASTType{
 //     FUNCTION
 // };
 
-class Type
+class Type : public PoolNode
 {
 public:
     virtual bool equals(Type* other)
@@ -162,18 +157,11 @@ public:
 
 inline void fail(string message, ASTDebug debug)
 {
-    string line = get_line_of_code(debug.line_number);
-    string location = file_name() + ":" + to_string(debug.line_number) + ":" + to_string(debug.start) + ": ";
-    
-    cout
-    << "Semantic Analysis failed. " << message << endl
-    << location << line << endl
-    << string(location.length() + debug.start, ' ') << "^" << string(debug.end - debug.start-1, '~') << endl;
-    exit(-1);
+    throw CompileError("Semantic Analysis failed. " + message, debug.line_number, debug.start, debug.end);
 }
 
 // abstract syntax tree (actually just a node in the AST)
-class AST
+class AST : public PoolNode
 {
 public:
     ASTType type;
@@ -185,14 +173,14 @@ public:
 	debug_info(_debug_info)
     {}
     
-    virtual IRNode* emit(vector<IRNode*>& result) {
+    virtual IRNode* emit(IRBuilder& result) {
 	result.push_back(new IRNode());
 	return new IRNode();
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map) {}
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context) {}
 
-    virtual void label_loops(string curr_loop_label) {}
+    virtual void label_loops(string curr_loop_label, CompileContext& context) {}
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table) { return nullptr; }
     
@@ -210,7 +198,7 @@ public:
     : AST(_type, debug)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	result.push_back(new IRStatement());
 	return new IRNode();
@@ -234,7 +222,7 @@ public:
 	items(_items)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	for (BlockItem* s : items) {
 	    s->emit(result);
@@ -243,14 +231,14 @@ public:
 	return new IRNode();
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
 	for (BlockItem* b : items) {
-	    b->label_loops(curr_loop_label);
+	    b->label_loops(curr_loop_label, context);
 	}
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map, bool new_scope = true)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context, bool new_scope = true)
     {
 	map<string, identifier> ident_map_copy;
 
@@ -260,7 +248,7 @@ public:
 	    ident_map_copy = ident_map;
 	
 	for (BlockItem* b : items) {
-	    b->resolve_identifiers(ident_map_copy);
+	    b->resolve_identifiers(ident_map_copy, context);
 	}
     }
 
@@ -291,7 +279,7 @@ public:
     : BlockItem(_type, debug)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	result.push_back(new IRStatement());
 	return new IRNode();
@@ -313,7 +301,7 @@ public:
 	Statement(_type, debug)
     {}
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	result.push_back(new IRExpr());
 	return new IROperand();
@@ -348,7 +336,7 @@ public:
 	val(_val)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	if (ident_map.count(name) > 0)
 	{
@@ -358,13 +346,13 @@ public:
 	    }
 	}
 
-	string unique_name = uniq_var_name(name);
+	string unique_name = context.uniq_var_name(name);
 
 	ident_map[name] = identifier(unique_name);
 
 	if (val)		// check if initializer value exists
 	{
-	    val->resolve_identifiers(ident_map);
+	    val->resolve_identifiers(ident_map, context);
 	}
 
 	name = unique_name;
@@ -380,11 +368,11 @@ public:
 	return nullptr;
     }
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	if (val)
 	{
-	    IRVar* dest_var = new IRVar(name);
+	    IRVar* dest_var = result.var(name);
 	    IROperand* value = val->emit(result);
 	    IRLoad* result_op = new IRLoad(dest_var, value);
 	    result.push_back(result_op);
@@ -420,7 +408,7 @@ public:
 	name(_name)
     {}
 
-    void resolve_identifiers(map<string, identifier>& ident_map)
+    void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	if (name == "")		// unnamed variable
 	    return;
@@ -433,7 +421,7 @@ public:
 	    }
 	}
 
-	string unique_name = uniq_var_name(name);
+	string unique_name = context.uniq_var_name(name);
 
 	ident_map[name] = identifier(unique_name);
 
@@ -465,13 +453,13 @@ public:
 	body(_body)
     {}
 
-    virtual void label_loops(string curr_loop_name)
+    virtual void label_loops(string curr_loop_name, CompileContext& context)
     {
 	if (body)
-	    body->label_loops(curr_loop_name);
+	    body->label_loops(curr_loop_name, context);
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	if (ident_map.count(name) > 0)
 	{
@@ -487,11 +475,11 @@ public:
 	map<string, identifier> ident_map_copy;
 	copy_ident_map(ident_map_copy, ident_map);
 	for (FunctionParam* param : params) {
-	    param->resolve_identifiers(ident_map_copy);
+	    param->resolve_identifiers(ident_map_copy, context);
 	}
 
 	if (body)
-	    body->resolve_identifiers(ident_map_copy, false);
+	    body->resolve_identifiers(ident_map_copy, context, false);
     }
 
     FunctionType* construct_type()
@@ -541,22 +529,25 @@ public:
 	return self_type;
     }
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	if(!body)
 	    return nullptr;
 	
 	result.push_back(new IRLabel(name));
 
+	// every function numbers its own virtual registers, starting with the params
+	IRBuilder ir_body(result.context);
+
 	vector<string> param_list;
 	for (FunctionParam* p : params) {
 	    param_list.push_back(p->name);
+	    ir_body.param(p->name);
 	}
 	
-	vector<IRNode*> ir_body;
 	body->emit(ir_body);
 	
-	return new IRFunction(name, param_list, ir_body);
+	return new IRFunction(name, param_list, ir_body.body, ir_body.var_names);
     }
 
     virtual ostream& pretty_print(ostream& out, int indentation)
@@ -588,7 +579,7 @@ public:
 	declarations(_functions)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 
 	vector<IRFunction*> functions;
@@ -607,17 +598,17 @@ public:
 	return new IRProgram(functions);
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
 	for (Declaration* decl : declarations) {
-	    decl->label_loops(curr_loop_label);
+	    decl->label_loops(curr_loop_label, context);
 	}
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	for (Declaration* decl : declarations) {
-	    decl->resolve_identifiers(ident_map);
+	    decl->resolve_identifiers(ident_map, context);
 	}
     }
 
@@ -654,7 +645,7 @@ public:
 	args(_args)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	if (ident_map.count(name) == 0)
 	{
@@ -664,7 +655,7 @@ public:
 	name = ident_map[name].name;
 
 	for(Expression* arg : args) {
-	    arg->resolve_identifiers(ident_map);
+	    arg->resolve_identifiers(ident_map, context);
 	}
     }
 
@@ -688,14 +679,14 @@ public:
 	return func_type->return_type;
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	vector<IROperand*> ir_args;
 	for(Expression* e : args) {
 	    ir_args.push_back(e->emit(result));
 	}
 
-	IRVar* dest = temp_var();
+	IRVar* dest = result.temp_var();
 
 	result.push_back(new IRFunctionCall(name, dest, ir_args));
 	
@@ -737,10 +728,10 @@ public:
     second(_s)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	first->resolve_identifiers(ident_map);
-	second->resolve_identifiers(ident_map);
+	first->resolve_identifiers(ident_map, context);
+	second->resolve_identifiers(ident_map, context);
     }
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table)
@@ -750,11 +741,11 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* src1 = first->emit(result);
 	IROperand* src2 = second->emit(result);
-	IRVar* dest = temp_var();
+	IRVar* dest = result.temp_var();
 
 	if(op == "+")
 	{
@@ -782,8 +773,8 @@ public:
 	}
 	else if (op == "&&")
 	{
-	    string fail_label = uniq_label();
-	    string end_label = uniq_label();
+	    string fail_label = result.context.uniq_label();
+	    string end_label = result.context.uniq_label();
 	    result.push_back(new IRJumpZero(src1, fail_label));
 	    result.push_back(new IRJumpZero(src2, fail_label));
 	    result.push_back(new IRLoad(dest, new IRConst(1)));
@@ -794,8 +785,8 @@ public:
 	}
 	else if (op == "||")
 	{
-	    string success_label = uniq_label();
-	    string end_label = uniq_label();
+	    string success_label = result.context.uniq_label();
+	    string end_label = result.context.uniq_label();
 	    result.push_back(new IRJumpNotZero(src1, success_label));
 	    result.push_back(new IRJumpNotZero(src2, success_label));
 	    result.push_back(new IRLoad(dest, new IRConst(0)));
@@ -852,7 +843,7 @@ public:
     : Expression(_type, debug)
     {}
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	result.push_back(new IRExpr());
 	return new IROperand();
@@ -878,9 +869,9 @@ public:
 	op(_op)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	inner->resolve_identifiers(ident_map);
+	inner->resolve_identifiers(ident_map, context);
     }
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table)
@@ -889,10 +880,10 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* src = inner->emit(result);
-	IRVar* dest = temp_var();
+	IRVar* dest = result.temp_var();
 
 	if(op == "-")
 	{
@@ -946,12 +937,12 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	inner->resolve_identifiers(ident_map);
+	inner->resolve_identifiers(ident_map, context);
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* src = inner->emit(result);
 
@@ -991,7 +982,7 @@ public:
 	return new PrimitiveType("int");
     }
     
-    virtual IRConst* emit(vector<IRNode*>& result)
+    virtual IRConst* emit(IRBuilder& result)
     {
         return new IRConst(val);
     }
@@ -1014,9 +1005,9 @@ public:
 	name(_name)
     {}
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
-	return new IRVar(name);
+	return result.var(name);
     }
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table)
@@ -1031,7 +1022,7 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	if (ident_map.count(name) == 0)
 	{
@@ -1062,7 +1053,7 @@ public:
 	src(_src)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 	if (dest->type != VAR)
 	{
@@ -1071,8 +1062,8 @@ public:
 	    fail("Invalid L-value " + s.str(), debug_info);
 	}
 
-	src->resolve_identifiers(ident_map);
-	dest->resolve_identifiers(ident_map);
+	src->resolve_identifiers(ident_map, context);
+	dest->resolve_identifiers(ident_map, context);
     }
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table)
@@ -1081,7 +1072,7 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* dest_var = dest->emit(result);
 	IROperand* value = src->emit(result);
@@ -1116,11 +1107,11 @@ public:
 	false_val(_false_val)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	cond->resolve_identifiers(ident_map);
-	true_val->resolve_identifiers(ident_map);
-	false_val->resolve_identifiers(ident_map);
+	cond->resolve_identifiers(ident_map, context);
+	true_val->resolve_identifiers(ident_map, context);
+	false_val->resolve_identifiers(ident_map, context);
     }
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table)
@@ -1131,14 +1122,14 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* cond_ptr = cond->emit(result);
 
-	IROperand* result_var = temp_var();
+	IROperand* result_var = result.temp_var();
 	
-	string false_label = uniq_label();
-	string end_label = uniq_label();
+	string false_label = result.context.uniq_label();
+	string end_label = result.context.uniq_label();
 	
 	result.push_back(new IRJumpZero(cond_ptr, false_label));
 	IROperand* true_result = true_val->emit(result);
@@ -1177,9 +1168,9 @@ public:
 	val(_val)
     {}
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	val->resolve_identifiers(ident_map);
+	val->resolve_identifiers(ident_map, context);
     }
 
     virtual Type* do_type_checking(map<string, symbol>& symbol_table)
@@ -1188,7 +1179,7 @@ public:
 	return new PrimitiveType("int");
     }
     
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* res_val = val->emit(result);
 	IRReturn* return_statement = new IRReturn(res_val);
@@ -1233,30 +1224,30 @@ public:
 	return nullptr;
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	cond->resolve_identifiers(ident_map);
-	then->resolve_identifiers(ident_map);
+	cond->resolve_identifiers(ident_map, context);
+	then->resolve_identifiers(ident_map, context);
 
 	if (otherwise)
-	    otherwise->resolve_identifiers(ident_map);
+	    otherwise->resolve_identifiers(ident_map, context);
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
-	then->label_loops(curr_loop_label);
+	then->label_loops(curr_loop_label, context);
 	if (otherwise)
-	    otherwise->label_loops(curr_loop_label);
+	    otherwise->label_loops(curr_loop_label, context);
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	IROperand* cond_ptr = cond->emit(result);
 
 	if (otherwise)		// if the condition has an else clause
 	{
-	    string else_label = uniq_label();
-	    string end_label = uniq_label();
+	    string else_label = result.context.uniq_label();
+	    string end_label = result.context.uniq_label();
 	
 	    result.push_back(new IRJumpZero(cond_ptr, else_label));
 	    then->emit(result);
@@ -1269,7 +1260,7 @@ public:
 	}
 	else			// lone if statement
 	{
-	    string end_label = uniq_label();
+	    string end_label = result.context.uniq_label();
 	
 	    result.push_back(new IRJumpZero(cond_ptr, end_label));
 	    then->emit(result);
@@ -1318,17 +1309,17 @@ public:
 	return new PrimitiveType("int");
     }
     
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	body->resolve_identifiers(ident_map);
+	body->resolve_identifiers(ident_map, context);
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
-	body->label_loops(curr_loop_label);
+	body->label_loops(curr_loop_label, context);
     }
 
-    virtual IROperand* emit(vector<IRNode*>& result)
+    virtual IROperand* emit(IRBuilder& result)
     {
 	for (BlockItem* b : body->items) {
 	    b->emit(result);
@@ -1369,7 +1360,7 @@ public:
 	label("")
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result) {
+    virtual IRNode* emit(IRBuilder& result) {
 
 	if (initializer)
 	    initializer->emit(result);
@@ -1407,13 +1398,13 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
-	label = uniq_loop_label("for");
-	body->label_loops(label);
+	label = context.uniq_loop_label("for");
+	body->label_loops(label, context);
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 
 	// as the for loop initializer introduces a new variable scope
@@ -1421,13 +1412,13 @@ public:
 	copy_ident_map(ident_map_copy, ident_map);
 	
 	if (initializer)
-	    initializer->resolve_identifiers(ident_map_copy);
+	    initializer->resolve_identifiers(ident_map_copy, context);
 	if (condition)
-	    condition->resolve_identifiers(ident_map_copy);
+	    condition->resolve_identifiers(ident_map_copy, context);
 	if (post)
-	    post->resolve_identifiers(ident_map_copy);
+	    post->resolve_identifiers(ident_map_copy, context);
 
-	body->resolve_identifiers(ident_map_copy);
+	body->resolve_identifiers(ident_map_copy, context);
     }
     
     virtual ostream& pretty_print(ostream& out, int indentation)
@@ -1462,7 +1453,7 @@ public:
 	body(_body)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result) {
+    virtual IRNode* emit(IRBuilder& result) {
 
 	result.push_back(new IRLabel("continue_" + label));
 	
@@ -1485,17 +1476,17 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
-	label = uniq_loop_label("while");
-	body->label_loops(label);
+	label = context.uniq_loop_label("while");
+	body->label_loops(label, context);
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
 
-	condition->resolve_identifiers(ident_map);
-	body->resolve_identifiers(ident_map);
+	condition->resolve_identifiers(ident_map, context);
+	body->resolve_identifiers(ident_map, context);
     }
     
     virtual ostream& pretty_print(ostream& out, int indentation)
@@ -1523,7 +1514,7 @@ public:
 	body(_body)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result) {
+    virtual IRNode* emit(IRBuilder& result) {
 
 	string start_label = "start_" + label;
 	result.push_back(new IRLabel(start_label));
@@ -1547,16 +1538,16 @@ public:
 	return new PrimitiveType("int");
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
-	label = uniq_loop_label("do");
-	body->label_loops(label);
+	label = context.uniq_loop_label("do");
+	body->label_loops(label, context);
     }
 
-    virtual void resolve_identifiers(map<string, identifier>& ident_map)
+    virtual void resolve_identifiers(map<string, identifier>& ident_map, CompileContext& context)
     {
-	condition->resolve_identifiers(ident_map);
-	body->resolve_identifiers(ident_map);
+	condition->resolve_identifiers(ident_map, context);
+	body->resolve_identifiers(ident_map, context);
     }
     
     virtual ostream& pretty_print(ostream& out, int indentation)
@@ -1583,13 +1574,13 @@ public:
 	Statement(BREAK, _debug)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	result.push_back(new IRJump("break_" + label));
 	return nullptr;
     }
     
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
 	label = curr_loop_label;
     }
@@ -1612,13 +1603,13 @@ public:
 	Statement(CONTINUE, _debug)
     {}
 
-    virtual IRNode* emit(vector<IRNode*>& result)
+    virtual IRNode* emit(IRBuilder& result)
     {
 	result.push_back(new IRJump("continue_" + label));
 	return nullptr;
     }
 
-    virtual void label_loops(string curr_loop_label)
+    virtual void label_loops(string curr_loop_label, CompileContext& context)
     {
 	label = curr_loop_label;
     }
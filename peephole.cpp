@@ -0,0 +1,363 @@
+#include "peephole.hpp"
+
+#include <map>
+#include <tuple>
+
+using namespace std;
+
+// the places an instruction reads or writes, r0 - r15 are 0 - 15
+#define LOC_A 16
+#define LOC_B 17
+#define LOC_SP 18
+#define LOC_FLAGS 19
+#define LOC_MEM 20
+#define NUM_LOCS 21
+
+#define BIT(loc) (1u << (loc))
+#define ALL_LOCS ((1u << NUM_LOCS) - 1)
+
+// never live across labels and jumps
+#define SCRATCH_LOCS (BIT(LOC_A) | BIT(LOC_B) | BIT(12) | BIT(13) | BIT(14))
+
+class Effect
+{
+public:
+    bool known;			// unknown instructions may touch anything
+    bool pure;			// no memory write, stack or control flow change
+    bool jump;
+    unsigned reads;
+    unsigned writes;
+};
+
+static bool is_jump(const string& name)
+{
+    return name == "jmp" || name == "jz" || name == "je" || name == "jl" || name == "jg";
+}
+
+static Effect effect_of(const MInstr& inst)
+{
+    Effect e{false, false, false, 0, 0};
+    const string& n = inst.name;
+
+    int reg = -1;
+    if (inst.operands.size() == 1 && inst.operands[0].kind == MOP_REG)
+	reg = inst.operands[0].value;
+    if (reg < -1 || reg > 15)
+	return e;
+
+    bool no_operands = inst.operands.empty();
+    auto set = [&](bool pure, unsigned reads, unsigned writes) {
+	e = Effect{true, pure, false, reads, writes};
+    };
+
+    if (n == "ldar" && reg != -1)		set(true, BIT(reg), BIT(LOC_A));
+    else if (n == "ldbr" && reg != -1)		set(true, BIT(reg), BIT(LOC_B));
+    else if (n == "ldra" && reg != -1)		set(true, BIT(LOC_A), BIT(reg));
+    else if (n == "ldrb" && reg != -1)		set(true, BIT(LOC_B), BIT(reg));
+    else if (n == "ldrs" && reg != -1)		set(true, BIT(LOC_SP), BIT(reg));
+    else if (n == "ldai" && inst.operands.size() == 1 && inst.operands[0].kind == MOP_IMM)
+	set(true, 0, BIT(LOC_A));
+    else if (n == "ldbi" && inst.operands.size() == 1 && inst.operands[0].kind == MOP_IMM)
+	set(true, 0, BIT(LOC_B));
+    else if ((n == "add" || n == "sub" || n == "and") && no_operands)
+	set(true, BIT(LOC_A) | BIT(LOC_B), BIT(LOC_A));
+    else if (n == "cmp" && no_operands)		set(true, BIT(LOC_A) | BIT(LOC_B), BIT(LOC_FLAGS));
+    else if (n == "ldmaa" && no_operands)	set(true, BIT(LOC_A) | BIT(LOC_MEM), BIT(LOC_A));
+    else if (n == "ldas" && no_operands)	set(true, BIT(LOC_SP), BIT(LOC_A));
+    else if (n == "ldmra" && reg != -1)		set(false, BIT(LOC_A) | BIT(reg), BIT(LOC_MEM));
+    else if (n == "ldsa" && no_operands)	set(false, BIT(LOC_A), BIT(LOC_SP));
+    else if (n == "ldsr" && reg != -1)		set(false, BIT(reg), BIT(LOC_SP));
+    else if (n == "lds" && inst.operands.size() == 1 && inst.operands[0].kind == MOP_IMM)
+	set(false, 0, BIT(LOC_SP));
+    else if (is_jump(n))
+    {
+	set(false, BIT(LOC_FLAGS), 0);
+	e.jump = true;
+    }
+
+    return e;
+}
+
+// local value numbering of the registers and of the stack slots
+class ValueState
+{
+public:
+    int next_value = 0;
+    vector<int> locs = vector<int>(LOC_FLAGS + 1);
+    map<int, int> memory;	// address value -> stored value
+
+    map<int, int> constants;	// 16 bit constant -> value
+    map<int, int> constant_values;
+    map<tuple<string, int, int>, int> expressions;
+    map<int, pair<int, int>> addresses; // value -> base value, offset
+    map<pair<int, int>, int> address_values;
+
+    int fresh()
+    {
+	return next_value++;
+    }
+
+    void forget()
+    {
+	for (int& value : locs)
+	    value = fresh();
+	memory.clear();
+    }
+
+    int constant(int c)
+    {
+	c &= 0xffff;
+	if (constants.count(c) == 0)
+	{
+	    constants[c] = fresh();
+	    constant_values[constants[c]] = c;
+	}
+	return constants[c];
+    }
+
+    bool constant_of(int value, int& c)
+    {
+	auto it = constant_values.find(value);
+	if (it == constant_values.end())
+	    return false;
+	c = it->second;
+	return true;
+    }
+
+    int expression(string op, int a, int b)
+    {
+	auto key = make_tuple(op, a, b);
+	if (expressions.count(key) == 0)
+	    expressions[key] = fresh();
+	return expressions[key];
+    }
+
+    // base + offset, so that slots of the same frame can be told apart
+    int address(int base, int offset)
+    {
+	if (addresses.count(base))
+	{
+	    offset += addresses[base].second;
+	    base = addresses[base].first;
+	}
+
+	auto key = make_pair(base, offset);
+	if (address_values.count(key) == 0)
+	{
+	    address_values[key] = fresh();
+	    addresses[address_values[key]] = key;
+	}
+	return address_values[key];
+    }
+
+    // any value is an address, at offset 0 from itself if nothing else
+    pair<int, int> as_address(int value)
+    {
+	return addresses.count(value) ? addresses[value] : make_pair(value, 0);
+    }
+
+    bool distinct_addresses(int a, int b)
+    {
+	pair<int, int> x = as_address(a), y = as_address(b);
+	return x.first == y.first && x.second != y.second;
+    }
+
+    void store(int address, int value)
+    {
+	for (auto it = memory.begin(); it != memory.end();) {
+	    if (distinct_addresses(it->first, address))
+		it++;
+	    else
+		it = memory.erase(it);
+	}
+	memory[address] = value;
+    }
+
+    void apply(const MInstr& inst, const Effect& e)
+    {
+	if (!e.known)
+	{
+	    forget();
+	    return;
+	}
+
+	// the dead code pass takes the scratch registers as dead after a
+	// jump, so what they hold cannot be used on the fall through side
+	if (e.jump)
+	{
+	    for (int loc = 0; loc <= LOC_FLAGS; loc++) {
+		if (SCRATCH_LOCS & BIT(loc))
+		    locs[loc] = fresh();
+	    }
+	    return;
+	}
+
+	const string& n = inst.name;
+	int reg = inst.operands.empty() ? 0 : inst.operands[0].value;
+	int& A = locs[LOC_A];
+	int& B = locs[LOC_B];
+
+	if (n == "ldar") A = locs[reg];
+	else if (n == "ldbr") B = locs[reg];
+	else if (n == "ldra") locs[reg] = A;
+	else if (n == "ldrb") locs[reg] = B;
+	else if (n == "ldrs") locs[reg] = locs[LOC_SP];
+	else if (n == "ldai") A = constant(inst.operands[0].value);
+	else if (n == "ldbi") B = constant(inst.operands[0].value);
+	else if (n == "add" || n == "sub")
+	{
+	    int c;
+	    if (constant_of(B, c))
+		A = address(A, n == "add" ? (short)c : -(short)c);
+	    else
+		A = expression(n, A, B);
+	}
+	else if (n == "and") A = expression(n, A, B);
+	else if (n == "cmp") locs[LOC_FLAGS] = expression(n, A, B);
+	else if (n == "ldmaa")
+	{
+	    if (memory.count(A) == 0)
+		memory[A] = fresh();
+	    A = memory[A];
+	}
+	else if (n == "ldas") A = locs[LOC_SP];
+	else if (n == "ldmra") store(A, locs[reg]);
+	else if (n == "ldsa") locs[LOC_SP] = A;
+	else if (n == "ldsr") locs[LOC_SP] = locs[reg];
+	else if (n == "lds") locs[LOC_SP] = constant(inst.operands[0].value);
+    }
+};
+
+// forward pass, removes runs that change nothing and forwards stored values
+static bool forward_pass(MachineCode& code, vector<bool>& removed)
+{
+    bool changed = false;
+    ValueState state;
+    state.forget();
+
+    vector<MInstr>& instrs = code.instrs;
+    for (int i = 0; i < instrs.size(); i++) {
+	if (instrs[i].kind == MI_LABEL)
+	    state.forget();
+	if (!instrs[i].is_instruction() || removed[i])
+	    continue;
+
+	// the next (up to) three instructions, all pure, with no label in between
+	vector<int> window;
+	for (int j = i; j < instrs.size() && window.size() < 3; j++) {
+	    if (instrs[j].kind == MI_LABEL)
+		break;
+	    if (!instrs[j].is_instruction() || removed[j])
+		continue;
+	    Effect e = effect_of(instrs[j]);
+	    if (!e.known || !e.pure)
+		break;
+	    window.push_back(j);
+	}
+
+	// pure instructions only add to the tables, so they can be tried
+	// out on the state itself as long as the registers are put back
+	bool deleted = false;
+	for (int w = 1; w <= window.size() && !deleted; w++) {
+	    vector<int> before = state.locs;
+	    for (int k = 0; k < w; k++)
+		state.apply(instrs[window[k]], effect_of(instrs[window[k]]));
+
+	    bool same = state.locs == before;
+	    state.locs = before;
+	    if (same)
+	    {
+		for (int k = 0; k < w; k++)
+		    removed[window[k]] = true;
+		deleted = changed = true;
+		i = window[w - 1];
+	    }
+	}
+	if (deleted)
+	    continue;
+
+	// the value of the slot is still in a register, move it from there
+	MInstr& inst = instrs[i];
+	if (inst.name == "ldmaa" && inst.operands.empty() && state.memory.count(state.locs[LOC_A]))
+	{
+	    int value = state.memory[state.locs[LOC_A]];
+	    for (int r = 0; r < 16; r++) {
+		if (state.locs[r] == value)
+		{
+		    inst = MInstr(MI_INSTR, "ldar", {MOperand::reg(r)}, "value of the slot is still in %r" + to_string(r));
+		    changed = true;
+		    break;
+		}
+	    }
+	}
+
+	state.apply(inst, effect_of(inst));
+    }
+
+    return changed;
+}
+
+// backward pass, removes pure instructions whose results are never read
+static bool dead_code_pass(MachineCode& code, vector<bool>& removed)
+{
+    bool changed = false;
+    unsigned boundary = ALL_LOCS & ~SCRATCH_LOCS;
+    unsigned live = boundary;
+
+    vector<MInstr>& instrs = code.instrs;
+    for (int i = instrs.size() - 1; i >= 0; i--) {
+	if (instrs[i].kind == MI_LABEL)
+	    live = boundary;
+	if (!instrs[i].is_instruction() || removed[i])
+	    continue;
+
+	Effect e = effect_of(instrs[i]);
+	if (!e.known)
+	{
+	    live = ALL_LOCS;
+	    continue;
+	}
+	if (e.jump)
+	{
+	    live = boundary;
+	    continue;
+	}
+
+	if (e.pure && (e.writes & live) == 0)
+	{
+	    removed[i] = changed = true;
+	    continue;
+	}
+
+	live = (live & ~(e.writes & ~BIT(LOC_MEM))) | e.reads;
+    }
+
+    return changed;
+}
+
+int peephole(MachineCode& code)
+{
+    int before = 0;
+    for (MInstr& inst : code.instrs)
+	before += inst.is_instruction();
+
+    bool changed = true;
+    while (changed) {
+	vector<bool> removed(code.instrs.size(), false);
+	changed = forward_pass(code, removed);
+	changed |= dead_code_pass(code, removed);
+
+	vector<MInstr> kept;
+	for (int i = 0; i < code.instrs.size(); i++) {
+	    if (!removed[i])
+		kept.push_back(code.instrs[i]);
+	}
+	code.instrs = kept;
+    }
+    code.renumber();
+
+    int after = 0;
+    for (MInstr& inst : code.instrs)
+	after += inst.is_instruction();
+    return before - after;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "machine.hpp"
+
+// Peephole optimization of the machine code of the compiled functions,
+// repeated until nothing changes:
+//
+//   - runs of up to three instructions that leave every register as it
+//     was are removed (ldra %r12 / ldar %r12, a repeated address
+//     computation)
+//   - ldmaa of a stack slot whose value is still in a register becomes a
+//     move from that register (a store followed by a load of the slot)
+//   - writes to A, B and the scratch registers r12 - r14 that are never
+//     read are removed (the restores at the end of a stack store)
+//
+// Values are tracked with local value numbering, which starts over at
+// every label and after every instruction it does not know. The ALU
+// registers and scratch registers are never live across a label or a
+// jump, as every ASM node loads its own operands.
+//
+// Returns the number of instructions removed.
+int peephole(MachineCode& code);
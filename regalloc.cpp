@@ -0,0 +1,398 @@
+#include "regalloc.hpp"
+#include "asm.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <map>
+
+using namespace std;
+
+#define NUM_REGS (LAST_ALLOCATABLE_REG - FIRST_ALLOCATABLE_REG + 1)
+
+// the registers r1 - r11 are entities 0 - 10, the vregs come after them,
+// so the registers are always the low bits of the first word of a set
+#define REG_ENTITY(name) ((name) - FIRST_ALLOCATABLE_REG)
+#define VREG_ENTITY(v) (NUM_REGS + (v))
+
+// a set of registers and vregs, one bit each
+class LiveSet
+{
+public:
+    vector<unsigned long long> words;
+
+    LiveSet(int size = 0) : words((size + 63) / 64, 0) {}
+
+    bool test(int i) const
+    {
+	return (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    void set(int i)
+    {
+	words[i / 64] |= 1ULL << (i % 64);
+    }
+
+    void reset(int i)
+    {
+	words[i / 64] &= ~(1ULL << (i % 64));
+    }
+
+    // calls f with each member from first on, skipping the empty words
+    template <typename F>
+    void for_each(int first, F f) const
+    {
+	for (int w = first / 64; w < words.size(); w++) {
+	    unsigned long long bits = words[w];
+	    if (w == first / 64)
+		bits &= ~0ULL << (first % 64);
+	    for (; bits != 0; bits &= bits - 1)
+		f(w * 64 + __builtin_ctzll(bits));
+	}
+    }
+};
+
+// the same set for every block, all in one array
+class BlockSets
+{
+public:
+    int words;
+    vector<unsigned long long> bits;
+
+    BlockSets(int blocks, int entities) : words((entities + 63) / 64), bits(blocks * words, 0) {}
+
+    unsigned long long* operator[](int block)
+    {
+	return &bits[block * words];
+    }
+};
+
+// a straight run of instructions, [start, end] are positions in the body
+class BasicBlock
+{
+public:
+    int start;
+    int end;
+    int successors[2];
+    int num_successors;
+};
+
+// the entities each node of the body reads and writes, worked out once:
+// node i reads entities[first[2 * i]] up to entities[first[2 * i + 1]]
+// and writes the ones from there up to entities[first[2 * i + 2]]
+class Accesses
+{
+public:
+    vector<int> entities;
+    vector<int> first;
+
+    const int* reads_begin(int i) const { return &entities[0] + first[2 * i]; }
+    const int* reads_end(int i) const { return &entities[0] + first[2 * i + 1]; }
+    const int* writes_begin(int i) const { return reads_end(i); }
+    const int* writes_end(int i) const { return &entities[0] + first[2 * i + 2]; }
+};
+
+static int entity_of(ASMOperand* op)
+{
+    if (op->type == PSUEDO)
+	return VREG_ENTITY(((ASMPsuedoReg*)op)->reg);
+
+    if (op->type == REGISTER)
+    {
+	Register name = ((ASMRegister*)op)->name;
+	if (name >= FIRST_ALLOCATABLE_REG && name <= LAST_ALLOCATABLE_REG)
+	    return REG_ENTITY(name);
+    }
+
+    return -1;
+}
+
+static Accesses find_accesses(vector<ASMNode*>& body)
+{
+    Accesses result;
+    vector<ASMOperand*> read_ops, write_ops;
+
+    for (ASMNode* node : body) {
+	result.first.push_back(result.entities.size());
+
+	ASMCall* call = dynamic_cast<ASMCall*>(node);
+	if (call != nullptr)
+	{
+	    // the args of an intrinsic are in r1 onwards, the callee may use any register
+	    for (int i = 0; i < call->register_args; i++)
+		result.entities.push_back(i);
+	    result.first.push_back(result.entities.size());
+	    for (int r = 0; r < NUM_REGS; r++)
+		result.entities.push_back(r);
+	    continue;
+	}
+
+	read_ops.clear();
+	write_ops.clear();
+	node->operands(read_ops, write_ops);
+	for (ASMOperand* op : read_ops) {
+	    int entity = entity_of(op);
+	    if (entity != -1)
+		result.entities.push_back(entity);
+	}
+	result.first.push_back(result.entities.size());
+	for (ASMOperand* op : write_ops) {
+	    int entity = entity_of(op);
+	    if (entity != -1)
+		result.entities.push_back(entity);
+	}
+    }
+    result.first.push_back(result.entities.size());
+
+    // so that the pointers above are valid for an empty list too
+    result.entities.push_back(-1);
+    return result;
+}
+
+// the label a jump goes to, or nullptr for anything else; conditional
+// is set if it can also fall through
+static const string* jump_target(ASMNode* node, bool& conditional)
+{
+    conditional = true;
+    if (ASMJumpZero* jump = dynamic_cast<ASMJumpZero*>(node))
+	return &jump->jump_to;
+    if (ASMJumpLess* jump = dynamic_cast<ASMJumpLess*>(node))
+	return &jump->jump_to;
+    if (ASMJumpGreater* jump = dynamic_cast<ASMJumpGreater*>(node))
+	return &jump->jump_to;
+    if (ASMJump* jump = dynamic_cast<ASMJump*>(node))
+    {
+	conditional = false;
+	return &jump->jump_to;
+    }
+    return nullptr;
+}
+
+static vector<BasicBlock> build_blocks(vector<ASMNode*>& body)
+{
+    vector<BasicBlock> blocks;
+    vector<const string*> targets;	// of the jump that ends each block, if any
+    vector<bool> falls_through;
+    map<string, int> label_block;
+
+    bool leader = true;
+    for (int i = 0; i < body.size(); i++) {
+	ASMLabel* label = dynamic_cast<ASMLabel*>(body[i]);
+	if (leader || label != nullptr)
+	{
+	    blocks.push_back(BasicBlock{i, i, {}, 0});
+	    targets.push_back(nullptr);
+	    falls_through.push_back(true);
+	}
+	blocks.back().end = i;
+	if (label != nullptr)
+	    label_block[label->name] = blocks.size() - 1;
+
+	bool conditional;
+	const string* target = jump_target(body[i], conditional);
+	leader = true;
+	if (target != nullptr)
+	{
+	    targets.back() = target;
+	    falls_through.back() = conditional;
+	}
+	else if (dynamic_cast<ASMReturn*>(body[i]))
+	    falls_through.back() = false;
+	else
+	    leader = false;
+    }
+
+    for (int b = 0; b < blocks.size(); b++) {
+	BasicBlock& block = blocks[b];
+	if (targets[b] != nullptr && label_block.count(*targets[b]))
+	    block.successors[block.num_successors++] = label_block[*targets[b]];
+	if (falls_through[b] && b + 1 < blocks.size())
+	    block.successors[block.num_successors++] = b + 1;
+    }
+
+    return blocks;
+}
+
+static void compute_liveness(Accesses& access, vector<BasicBlock>& blocks, BlockSets& live_in, BlockSets& live_out)
+{
+    int words = live_in.words;
+    BlockSets use(blocks.size(), words * 64);	// read before being written in the block
+    BlockSets def(blocks.size(), words * 64);
+
+    for (int b = 0; b < blocks.size(); b++) {
+	unsigned long long* block_use = use[b];
+	unsigned long long* block_def = def[b];
+	for (int i = blocks[b].start; i <= blocks[b].end; i++) {
+	    for (const int* e = access.reads_begin(i); e != access.reads_end(i); e++) {
+		if (!((block_def[*e / 64] >> (*e % 64)) & 1))
+		    block_use[*e / 64] |= 1ULL << (*e % 64);
+	    }
+	    for (const int* e = access.writes_begin(i); e != access.writes_end(i); e++)
+		block_def[*e / 64] |= 1ULL << (*e % 64);
+	}
+    }
+
+    bool changed = true;
+    while (changed) {
+	changed = false;
+	for (int b = blocks.size() - 1; b >= 0; b--) {
+	    BasicBlock& block = blocks[b];
+	    unsigned long long* out = live_out[b];
+	    for (int s = 0; s < block.num_successors; s++) {
+		unsigned long long* succ_in = live_in[block.successors[s]];
+		for (int w = 0; w < words; w++)
+		    out[w] |= succ_in[w];
+	    }
+
+	    unsigned long long* in = live_in[b];
+	    unsigned long long* block_use = use[b];
+	    unsigned long long* block_def = def[b];
+	    for (int w = 0; w < words; w++) {
+		unsigned long long word = block_use[w] | (out[w] & ~block_def[w]);
+		if (word != in[w])
+		{
+		    in[w] = word;
+		    changed = true;
+		}
+	    }
+	}
+    }
+}
+
+void allocate_frame(vector<ASMNode*>& body, FrameLayout& frame)
+{
+    int num_vregs = frame.registers.size();
+    if (body.empty() || num_vregs == 0)
+	return;
+
+    int num_regs = NUM_REGS;
+    int entities = VREG_ENTITY(num_vregs);
+    Accesses access = find_accesses(body);
+    vector<BasicBlock> blocks = build_blocks(body);
+    BlockSets live_in(blocks.size(), entities), live_out(blocks.size(), entities);
+    compute_liveness(access, blocks, live_in, live_out);
+
+    // a single interval per vreg, from the first to the last position it is live at
+    vector<int> start(num_vregs, INT_MAX), end(num_vregs, -1);
+    auto extend = [&](int v, int pos) {
+	start[v] = min(start[v], pos);
+	end[v] = max(end[v], pos);
+    };
+
+    // the positions at which a register is in use by the surrounding code
+    vector<vector<int>> blocked(num_regs);
+
+    LiveSet live(entities);
+    for (int b = 0; b < blocks.size(); b++) {
+	BasicBlock& block = blocks[b];
+	copy(live_out[b], live_out[b] + live.words.size(), live.words.begin());
+	live.for_each(VREG_ENTITY(0), [&](int e) { extend(e - NUM_REGS, block.end); });
+
+	for (int i = block.end; i >= block.start; i--) {
+	    for (unsigned regs = live.words[0] & ((1u << NUM_REGS) - 1); regs != 0; regs &= regs - 1)
+		blocked[__builtin_ctz(regs)].push_back(i);
+
+	    for (const int* e = access.writes_begin(i); e != access.writes_end(i); e++) {
+		if (*e >= NUM_REGS)
+		    extend(*e - NUM_REGS, i);
+		else
+		    blocked[*e].push_back(i);
+		live.reset(*e);
+	    }
+	    for (const int* e = access.reads_begin(i); e != access.reads_end(i); e++) {
+		if (*e >= NUM_REGS)
+		    extend(*e - NUM_REGS, i);
+		else
+		    blocked[*e].push_back(i);
+		live.set(*e);
+	    }
+	}
+
+	copy(live_in[b], live_in[b] + live.words.size(), live.words.begin());
+	live.for_each(VREG_ENTITY(0), [&](int e) { extend(e - NUM_REGS, block.start); });
+    }
+
+    for (vector<int>& positions : blocked)
+	sort(positions.begin(), positions.end());
+
+    auto is_blocked = [&](int r, int from, int to) {
+	auto it = lower_bound(blocked[r].begin(), blocked[r].end(), from);
+	return it != blocked[r].end() && *it <= to;
+    };
+
+    vector<int> order;
+    for (int v = 0; v < num_vregs; v++) {
+	if (end[v] != -1)
+	    order.push_back(v);
+    }
+    sort(order.begin(), order.end(), [&](int a, int b) {
+	return start[a] != start[b] ? start[a] < start[b] : a < b;
+    });
+
+    vector<int> active;		// vregs holding a register, r - FIRST_ALLOCATABLE_REG
+    vector<int> assigned(num_vregs, -1);
+    for (int v : order) {
+	// free the registers of the intervals that are over
+	int kept = 0;
+	unsigned in_use = 0;
+	for (int i = 0; i < active.size(); i++) {
+	    if (end[active[i]] >= start[v])
+	    {
+		active[kept++] = active[i];
+		in_use |= 1u << assigned[active[i]];
+	    }
+	}
+	active.resize(kept);
+
+	int reg = -1;
+	for (int r = 0; r < num_regs && reg == -1; r++) {
+	    if (!(in_use >> r & 1) && !is_blocked(r, start[v], end[v]))
+		reg = r;
+	}
+
+	if (reg != -1)
+	{
+	    assigned[v] = reg;
+	    active.push_back(v);
+	    continue;
+	}
+
+	// out of registers, spill whichever interval ends last
+	int victim = -1;
+	for (int i = 0; i < active.size(); i++) {
+	    int a = active[i];
+	    if (end[a] > end[v] && !is_blocked(assigned[a], start[v], end[v])
+		&& (victim == -1 || end[a] > end[active[victim]]))
+		victim = i;
+	}
+
+	if (victim != -1)
+	{
+	    assigned[v] = assigned[active[victim]];
+	    assigned[active[victim]] = -1;
+	    active[victim] = v;
+	}
+    }
+
+    for (int v = 0; v < num_vregs; v++) {
+	if (assigned[v] != -1)
+	    frame.registers[v] = assigned[v] + FIRST_ALLOCATABLE_REG;
+    }
+
+    // color the spilled intervals onto slots, order is still by start
+    vector<int> slot_end;	// end of the interval last put in each slot
+    for (int v : order) {
+	if (frame.registers[v] != -1)
+	    continue;
+
+	int slot = 0;
+	while (slot < slot_end.size() && slot_end[slot] >= start[v])
+	    slot++;
+
+	if (slot == slot_end.size())
+	    slot_end.push_back(end[v]);
+	else
+	    slot_end[slot] = end[v];
+	frame.slots[v] = slot;
+    }
+    frame.local_count = slot_end.size();
+}
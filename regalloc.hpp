@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+class ASMNode;
+
+// where legalize puts the vregs of a function: the register picked by
+// the allocator, else a stack slot (-1 for none)
+class FrameLayout
+{
+public:
+    vector<int> registers;
+    vector<int> slots;
+    int local_count;
+
+    FrameLayout(int num_vregs)
+	:
+	registers(num_vregs, -1),
+	slots(num_vregs, -1),
+	local_count(0)
+    {}
+};
+
+// Linear scan register allocation (Poletto and Sarkar) of the vregs of
+// one function onto the general purpose registers r1 - r11. r0 holds
+// return values, r12 - r14 are scratch for the stack and push code and
+// r15 is rbp, so none of those are handed out.
+//
+// Every vreg gets one live interval over the instruction positions of
+// body. Calls clobber all of the registers, so a vreg live across one
+// stays on the stack, as does anything that loses out under pressure.
+// The spilled intervals are then colored onto stack slots, so vregs
+// that are never live at the same time share a slot.
+void allocate_frame(vector<ASMNode*>& body, FrameLayout& frame);
+
+#define FIRST_ALLOCATABLE_REG 1
+#define LAST_ALLOCATABLE_REG 11
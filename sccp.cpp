@@ -0,0 +1,287 @@
+#include "sccp.hpp"
+#include "combine.hpp"
+#include "ssa.hpp"
+
+#include <map>
+#include <set>
+
+using namespace std;
+
+enum LatticeState
+{
+    UNKNOWN,			// no write of it has been reached yet
+    CONSTANT,
+    VARYING
+};
+
+class LatticeValue
+{
+public:
+    LatticeState state;
+    int value;
+
+    bool operator!=(const LatticeValue& other) const
+    {
+	return state != other.state || (state == CONSTANT && value != other.value);
+    }
+};
+
+class SCCP
+{
+public:
+    IRCode& code;
+    CFG& cfg;
+    SSAForm& ssa;
+
+    vector<LatticeValue> values;	// of every version
+    vector<vector<int>> users;	// instructions, and phis as -(id + 1)
+    map<int, int> label_block;
+
+    vector<bool> executable;	// of every block
+    set<pair<int, int>> taken;	// edges
+    vector<pair<int, int>> flow_worklist;
+    vector<int> ssa_worklist;
+
+    SCCP(IRCode& _code, CFG& _cfg, SSAForm& _ssa)
+	:
+	code(_code),
+	cfg(_cfg),
+	ssa(_ssa),
+	values(_ssa.num_versions(), LatticeValue{UNKNOWN, 0}),
+	users(_ssa.num_versions()),
+	executable(_cfg.blocks.size(), false)
+    {
+	// the values on entry, params or not, are not known
+	for (int v = 0; v < ssa.num_vars; v++)
+	    values[v] = LatticeValue{VARYING, 0};
+
+	for (int b : ssa.dom.rpo) {
+	    for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+		IRInst& inst = code.insts[i];
+		if (inst.op == IR_LABEL)
+		    label_block[inst.dest.id] = b;
+		for_each_use(code, inst, [&](IRValue& v) {
+		    if (v.is_vreg())
+			users[v.id].push_back(i);
+		});
+	    }
+	}
+	for (int id = 0; id < ssa.phis.size(); id++) {
+	    for (int arg : ssa.phis[id].args)
+		users[arg].push_back(-(id + 1));
+	}
+    }
+
+    LatticeValue operand(IRValue v)
+    {
+	if (v.is_const())
+	    return LatticeValue{CONSTANT, v.id};
+	return values[v.id];
+    }
+
+    void update(int version, LatticeValue value)
+    {
+	if (values[version] != value)
+	{
+	    values[version] = value;
+	    ssa_worklist.push_back(version);
+	}
+    }
+
+    void visit_phi(int id)
+    {
+	Phi& phi = ssa.phis[id];
+
+	// the entry block is also entered from outside
+	if (phi.block == 0)
+	{
+	    update(phi.dest, LatticeValue{VARYING, 0});
+	    return;
+	}
+
+	LatticeValue result{UNKNOWN, 0};
+	vector<int>& preds = cfg.blocks[phi.block].preds;
+	for (int e = 0; e < preds.size(); e++) {
+	    if (taken.count({preds[e], phi.block}) == 0)
+		continue;
+
+	    LatticeValue arg = values[phi.args[e]];
+	    if (arg.state == UNKNOWN)
+		continue;
+	    if (result.state == UNKNOWN)
+		result = arg;
+	    else if (result != arg)
+		result = LatticeValue{VARYING, 0};
+	}
+	update(phi.dest, result);
+    }
+
+    LatticeValue evaluate(IRInst& inst)
+    {
+	if (inst.op == IR_LOAD)
+	    return operand(inst.src1);
+	if (!is_pure(inst.op))
+	    return LatticeValue{VARYING, 0};
+
+	LatticeValue a = operand(inst.src1);
+	LatticeValue b = is_binary(inst.op) ? operand(inst.src2) : LatticeValue{CONSTANT, 0};
+
+	// x * 0 and x & 0 are known whatever x is
+	if ((inst.op == IR_MUL || inst.op == IR_BITAND)
+	    && ((a.state == CONSTANT && (short)a.value == 0) || (b.state == CONSTANT && (short)b.value == 0)))
+	    return LatticeValue{CONSTANT, 0};
+
+	if (a.state == VARYING || b.state == VARYING)
+	    return LatticeValue{VARYING, 0};
+	if (a.state == UNKNOWN || b.state == UNKNOWN)
+	    return LatticeValue{UNKNOWN, 0};
+
+	int result;
+	if (!fold_constant(inst.op, a.value, b.value, result))
+	    return LatticeValue{VARYING, 0};
+	return LatticeValue{CONSTANT, result};
+    }
+
+    void visit_terminator(int b)
+    {
+	IRInst& last = code.insts[cfg.blocks[b].end];
+	bool has_next = b + 1 < cfg.blocks.size();
+
+	switch (last.op)
+	{
+	case IR_RETURN:
+	    break;
+	case IR_JUMP:
+	    flow_worklist.push_back({b, label_block[last.src1.id]});
+	    break;
+	case IR_JUMP_ZERO:
+	case IR_JUMP_NOT_ZERO:
+	{
+	    LatticeValue cond = operand(last.src1);
+	    int target = label_block[last.src2.id];
+	    if (cond.state == CONSTANT)
+	    {
+		bool jumps = ((short)cond.value == 0) == (last.op == IR_JUMP_ZERO);
+		if (jumps)
+		    flow_worklist.push_back({b, target});
+		else if (has_next)
+		    flow_worklist.push_back({b, b + 1});
+	    }
+	    else if (cond.state == VARYING)
+	    {
+		flow_worklist.push_back({b, target});
+		if (has_next)
+		    flow_worklist.push_back({b, b + 1});
+	    }
+	    break;
+	}
+	default:
+	    if (has_next)
+		flow_worklist.push_back({b, b + 1});
+	    break;
+	}
+    }
+
+    void visit_inst(int i)
+    {
+	IRInst& inst = code.insts[i];
+	if (defined_vreg(inst) != -1)
+	    update(inst.dest.id, evaluate(inst));
+
+	int b = cfg.block_of[i];
+	if (i == cfg.blocks[b].end)
+	    visit_terminator(b);
+    }
+
+    void run()
+    {
+	executable[0] = true;
+	for (int id : ssa.block_phis[0])
+	    visit_phi(id);
+	for (int i = cfg.blocks[0].start; i <= cfg.blocks[0].end; i++)
+	    visit_inst(i);
+
+	while (!flow_worklist.empty() || !ssa_worklist.empty()) {
+	    if (!flow_worklist.empty())
+	    {
+		pair<int, int> edge = flow_worklist.back();
+		flow_worklist.pop_back();
+		if (taken.count(edge))
+		    continue;
+		taken.insert(edge);
+
+		int b = edge.second;
+		for (int id : ssa.block_phis[b])
+		    visit_phi(id);
+		if (executable[b])
+		    continue;
+
+		executable[b] = true;
+		for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++)
+		    visit_inst(i);
+		continue;
+	    }
+
+	    int version = ssa_worklist.back();
+	    ssa_worklist.pop_back();
+	    for (int user : users[version]) {
+		if (user < 0)
+		{
+		    int id = -user - 1;
+		    if (executable[ssa.phis[id].block])
+			visit_phi(id);
+		}
+		else if (executable[cfg.block_of[user]])
+		    visit_inst(user);
+	    }
+	}
+    }
+
+    // replaces the reads of constant versions, returns how many
+    int rewrite()
+    {
+	int replaced = 0;
+	for (int b = 0; b < cfg.blocks.size(); b++) {
+	    if (!executable[b])
+		continue;
+
+	    for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+		IRInst& inst = code.insts[i];
+		for_each_use(code, inst, [&](IRValue& v) {
+		    if (v.is_vreg() && values[v.id].state == CONSTANT)
+		    {
+			v = IRValue::constant(values[v.id].value);
+			replaced++;
+		    }
+		});
+
+		// the result of a phi, or of an operation on one
+		if (is_pure(inst.op) && values[inst.dest.id].state == CONSTANT
+		    && !(inst.op == IR_LOAD && inst.src1.is_const()))
+		{
+		    inst = IRInst(IR_LOAD, inst.dest, IRValue::constant(values[inst.dest.id].value));
+		    replaced++;
+		}
+	    }
+	}
+	return replaced;
+    }
+};
+
+int propagate_constants(IRCode& code)
+{
+    code.compact();
+    if (code.insts.empty())
+	return 0;
+
+    CFG cfg(code);
+    DominatorTree dom(cfg);
+    SSAForm ssa(code, cfg, dom);
+
+    SCCP sccp(code, cfg, ssa);
+    sccp.run();
+    int replaced = sccp.rewrite();
+
+    ssa.leave();
+    return replaced;
+}
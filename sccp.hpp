@@ -0,0 +1,18 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Sparse conditional constant propagation on the SSA form of one
+// function, as in Wegman and Zadeck.
+//
+// Every version starts out unknown and only ever goes down to a constant
+// and then to not constant. Blocks are only looked at once an edge into
+// them is found to be taken, so a constant that decides a branch keeps
+// the values coming from the other side out of the phis after it.
+//
+// Reads of versions found constant are replaced with the constant, so the
+// branches that are never taken get a constant condition, and are folded
+// by combine_instructions and removed by eliminate_dead_code.
+//
+// Returns the number of reads replaced.
+int propagate_constants(IRCode& code);
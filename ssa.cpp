@@ -0,0 +1,126 @@
+#include "ssa.hpp"
+#include "dataflow.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+SSAForm::SSAForm(IRCode& _code, CFG& _cfg, DominatorTree& _dom)
+    :
+    code(_code),
+    cfg(_cfg),
+    dom(_dom)
+{
+    num_vars = code.num_vregs();
+    for (int v = 0; v < num_vars; v++) {
+	origin.push_back(v);
+	stacks.push_back({v});
+    }
+    block_phis.resize(cfg.blocks.size());
+
+    if (cfg.blocks.empty())
+	return;
+
+    place_phis();
+    rename(0);
+}
+
+void SSAForm::place_phis()
+{
+    DataflowResult live = live_variables(code, cfg);
+
+    // the blocks writing each vreg, the entry writes all of them
+    vector<vector<int>> def_blocks(num_vars, vector<int>{0});
+    for (int b : dom.rpo) {
+	for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	    int d = defined_vreg(code.insts[i]);
+	    if (d != -1 && def_blocks[d].back() != b)
+		def_blocks[d].push_back(b);
+	}
+    }
+
+    // the last vreg that got a phi in, or was queued for, every block
+    vector<int> has_phi(cfg.blocks.size(), -1);
+    vector<int> queued(cfg.blocks.size(), -1);
+
+    for (int v = 0; v < num_vars; v++) {
+	vector<int> worklist = def_blocks[v];
+	for (int b : worklist)
+	    queued[b] = v;
+
+	while (!worklist.empty()) {
+	    int b = worklist.back();
+	    worklist.pop_back();
+
+	    for (int f : dom.frontier[b]) {
+		if (has_phi[f] == v || !live.in[f].test(v))
+		    continue;
+
+		has_phi[f] = v;
+		phis.push_back(Phi{f, v, -1, vector<int>(cfg.blocks[f].preds.size(), v)});
+		block_phis[f].push_back(phis.size() - 1);
+
+		if (queued[f] != v)
+		{
+		    queued[f] = v;
+		    worklist.push_back(f);
+		}
+	    }
+	}
+    }
+}
+
+void SSAForm::rename(int b)
+{
+    vector<int> pushed;
+    auto new_version = [&](int var) {
+	origin.push_back(var);
+	stacks[var].push_back(origin.size() - 1);
+	pushed.push_back(var);
+	return origin.size() - 1;
+    };
+
+    for (int id : block_phis[b])
+	phis[id].dest = new_version(phis[id].var);
+
+    for (int i = cfg.blocks[b].start; i <= cfg.blocks[b].end; i++) {
+	IRInst& inst = code.insts[i];
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v.is_vreg())
+		v.id = stacks[v.id].back();
+	});
+
+	int d = defined_vreg(inst);
+	if (d != -1)
+	    inst.dest.id = new_version(d);
+    }
+
+    for (int s : cfg.blocks[b].succs) {
+	vector<int>& preds = cfg.blocks[s].preds;
+	int edge = find(preds.begin(), preds.end(), b) - preds.begin();
+	for (int id : block_phis[s])
+	    phis[id].args[edge] = stacks[phis[id].var].back();
+    }
+
+    for (int child : dom.children[b])
+	rename(child);
+
+    for (int var : pushed)
+	stacks[var].pop_back();
+}
+
+void SSAForm::leave()
+{
+    for (IRInst& inst : code.insts) {
+	for_each_use(code, inst, [&](IRValue& v) {
+	    if (v.is_vreg())
+		v.id = origin[v.id];
+	});
+	if (defined_vreg(inst) != -1)
+	    inst.dest.id = origin[inst.dest.id];
+    }
+
+    phis.clear();
+    for (vector<int>& ids : block_phis)
+	ids.clear();
+}
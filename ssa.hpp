@@ -0,0 +1,51 @@
+#pragma once
+
+#include "cfg.hpp"
+
+// SSA form of the TACKY of one function.
+//
+// Building it renames every write of a vreg to a version of its own, and
+// puts phis at the dominance frontiers of the writes where the vreg is
+// live (pruned SSA). Versions below num_vars are the values the vregs
+// have on entry, the params among them. The phis are kept next to the
+// code, not in it, so the other passes never see them.
+//
+// leave() maps every version back to its vreg and drops the phis. This
+// is only right as long as no two versions of a vreg are live at the
+// same time, which holds for passes that only replace reads with
+// constants; the versions then join again without any copies.
+
+class Phi
+{
+public:
+    int block;
+    int var;			// the vreg it merges
+    int dest;			// version
+    vector<int> args;		// version coming in from each pred of the block
+};
+
+class SSAForm
+{
+public:
+    IRCode& code;
+    CFG& cfg;
+    DominatorTree& dom;
+
+    int num_vars;		// the vregs before renaming
+    vector<int> origin;		// the vreg of every version
+    vector<Phi> phis;
+    vector<vector<int>> block_phis;
+
+    // renames the code in place
+    SSAForm(IRCode& code, CFG& cfg, DominatorTree& dom);
+
+    int num_versions() { return origin.size(); }
+
+    void leave();
+
+private:
+    vector<vector<int>> stacks;	// the current version of every vreg while renaming
+
+    void place_phis();
+    void rename(int b);
+};
@@ -3,24 +3,28 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <map>
+#include <unordered_map>
 
 #include "asm.hpp"
+#include "ircode.hpp"
+#include "intrinsics.hpp"
 
 using namespace std;
 
-string uniq_label();
 
-bool is_function_intrinsic(string name);
-
-class IRNode
+class IRNode : public PoolNode
 {
 public:
     virtual void pretty_print(ostream& out) { out << "Empty IR Node" << endl;}
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMNode());
     }
+
+    // appends the dense form of this node to code
+    virtual void encode(IRCode& code) {}
 };
 
 class IROperand : public IRNode
@@ -30,20 +34,28 @@ public:
     {
 	return new ASMOperand();
     }
+
+    virtual IRValue to_value(IRCode& code)
+    {
+	return IRValue();
+    }
 };
 
+// a virtual register, numbered densely from 0 within its function
 class IRVar : public IROperand
 {
 public:
-    string name;
-    IRVar(string _name) : name(_name) {}
+    int id;
+    IRVar(int _id) : id(_id) {}
 
-    virtual void pretty_print(ostream& out) { out << "Var(" << name << ")";}
+    virtual void pretty_print(ostream& out) { out << "Var(v" << id << ")";}
 
     virtual ASMOperand* to_asm()
     {
-	return new ASMPsuedoReg(name);
+	return new ASMPsuedoReg(id);
     }
+
+    virtual IRValue to_value(IRCode& code);
 };
 
 class IRConst : public IROperand
@@ -54,7 +66,7 @@ public:
 
     virtual void pretty_print(ostream& out) { out << "Const(" << value << ")";}
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMImmediate(value));
     }
@@ -63,6 +75,56 @@ public:
     {
 	return new ASMImmediate(value);
     }
+
+    virtual IRValue to_value(IRCode& code);
+};
+
+// collects the TACKY of one function while the AST is lowered and hands
+// out its virtual registers, the names are kept only for debugging
+class IRBuilder
+{
+public:
+    vector<IRNode*> body;
+    vector<string> var_names;	// indexed by vreg
+    unordered_map<string, int> var_ids;	// source variable -> vreg
+    int temp_count;
+    CompileContext& context;
+
+    IRBuilder(CompileContext& _context) : temp_count(0), context(_context) {}
+
+    void push_back(IRNode* node)
+    {
+	body.push_back(node);
+    }
+
+    IRVar* new_var(const string& name)
+    {
+	var_names.push_back(name);
+	return new IRVar(var_names.size() - 1);
+    }
+
+    // params always get a vreg of their own, even the unnamed ones
+    IRVar* param(const string& name)
+    {
+	IRVar* result = new_var(name);
+	var_ids[name] = result->id;
+	return result;
+    }
+
+    // the vreg of a (uniquely renamed) source variable
+    IRVar* var(const string& name)
+    {
+	auto it = var_ids.find(name);
+	if (it != var_ids.end())
+	    return new IRVar(it->second);
+
+	return param(name);
+    }
+
+    IRVar* temp_var()
+    {
+	return new_var("tmp" + to_string(temp_count++));
+    }
 };
 
 class IRExpr : public IRNode
@@ -96,10 +158,15 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMLoad(dest->to_asm(), src->to_asm()));
     }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(IR_LOAD, dest->to_value(code), src->to_value(code)));
+    }
 };
 
 class IRJump : public IRStatement
@@ -117,10 +184,15 @@ public:
 	out << "Jump(" << target << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMJump(target));
     }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(IR_JUMP, IRValue(), code.label(target)));
+    }
 };
 
 class IRJumpZero : public IRStatement
@@ -142,11 +214,16 @@ public:
 	out << ", " << target << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMCmp(condition->to_asm(), new ASMImmediate(0)));
 	result.push_back(new ASMJumpZero(target));
     }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(IR_JUMP_ZERO, IRValue(), condition->to_value(code), code.label(target)));
+    }
 };
 
 class IRJumpNotZero : public IRStatement
@@ -168,15 +245,20 @@ public:
 	out << ", " << target << ")" << endl;;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string fail_label = uniq_label();
+	string fail_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(condition->to_asm(), new ASMImmediate(0)));
 	result.push_back(new ASMJumpZero(fail_label));
 	result.push_back(new ASMJump(target));
 	result.push_back(new ASMLabel(fail_label));
     }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(IR_JUMP_NOT_ZERO, IRValue(), condition->to_value(code), code.label(target)));
+    }
 };
 
 class IRLabel : public IRStatement
@@ -194,10 +276,15 @@ public:
 	out << "Label(" << name << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMLabel(name));
     }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(IR_LABEL, code.label(name)));
+    }
 };
 
 class IRReturn : public IRStatement
@@ -213,11 +300,16 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMLoad(new ASMRegister(r0), val->to_asm()));
 	result.push_back(new ASMReturn());
     }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(IR_RETURN, IRValue(), val->to_value(code)));
+    }
 };
 
 class IRFunctionCall : public IRStatement
@@ -247,9 +339,9 @@ public:
 	out << "\b\b)" << endl;
     }
 
-    virtual void emit(vector<ASMNode *> &result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	if (is_function_intrinsic(name))
+	if (context.intrinsics->provides(name))
         {
 	    // put each operand in regsiters starting from r1,r2,...
 	    int i = 1;
@@ -265,7 +357,7 @@ public:
 		i++;
             }
 
-            result.push_back(new ASMCall(name));
+            result.push_back(new ASMCall(name, args.size()));
 	}
 	else
 	{    
@@ -288,20 +380,31 @@ public:
 	ASMOperand* return_location = dest->to_asm();
         result.push_back(new ASMLoad(return_location, new ASMRegister(r0)));
     }
+
+    virtual void encode(IRCode& code)
+    {
+	vector<IRValue> values;
+	for (IROperand* arg : args) {
+	    values.push_back(arg->to_value(code));
+	}
+	code.push_back(IRInst(IR_CALL, dest->to_value(code), code.label(name), code.args(values)));
+    }
 };
 
 class IRFunction : public IRNode
 {
 public:
     string name;
-    vector<string> params;
+    vector<string> params;	// the params are vregs 0 to params.size()-1
     vector<IRNode*> body;
+    vector<string> var_names;	// debug name of every vreg
     
-    IRFunction(string _name, vector<string>& _params, vector<IRNode*>& _body)
+    IRFunction(string _name, vector<string>& _params, vector<IRNode*>& _body, vector<string>& _var_names)
     :
 	name(_name),
 	params(_params),
-	body(_body)
+	body(_body),
+	var_names(_var_names)
     {}
     
     virtual void pretty_print(ostream& out)
@@ -312,6 +415,11 @@ public:
 	    out << param << ", ";
 	}
 	out << "\b\b)" << endl;
+
+	for (int i=0;i<var_names.size();i++) {
+	    out << "v" << i << "=" << var_names[i] << " ";
+	}
+	out << endl;
 	
 	for (IRNode* s : body)
 	{
@@ -320,23 +428,53 @@ public:
 	out << endl;
     }
 
-    virtual void emit(vector<ASMFunction*>& result)
+    // convert to and from the dense encoding, see ircode.hpp
+    IRCode encode();
+    void decode(IRCode& code);
+
+    virtual void emit(vector<ASMFunction*>& result, CompileContext& context)
     {
 	vector<ASMNode*> asm_body;
 
 	// args are pushed in reverse order
 	int stack_offset = -3; 	// because Stack(-1) is old val of rbp, Stack(-2) is return address
 	
-	for (string param : params) {
-	    asm_body.push_back(new ASMLoad(new ASMPsuedoReg(param), new ASMStack(stack_offset)));
+	for (int i=0;i<params.size();i++) {
+	    asm_body.push_back(new ASMLoad(new ASMPsuedoReg(i), new ASMStack(stack_offset)));
 	    stack_offset--;
 	}
 	
-	for (IRNode* s : body) {
-	    s->emit(asm_body);
+	for (int i = 0; i < body.size(); i++) {
+	    if (emit_tail_call(i, asm_body, context))
+		i++;		// the return is part of it
+	    else
+		body[i]->emit(asm_body, context);
 	}
 	
-	result.push_back(new ASMFunction(name, asm_body));
+	result.push_back(new ASMFunction(name, asm_body, var_names.size()));
+    }
+
+    // a call whose result is returned right away reuses the arg slots
+    // of this function and jumps to the callee in place of the return,
+    // so the callee returns straight to our caller. The callee must take
+    // no more args than this function, the slots for the rest are not ours
+    bool emit_tail_call(int i, vector<ASMNode*>& result, CompileContext& context)
+    {
+	IRFunctionCall* call = dynamic_cast<IRFunctionCall*>(body[i]);
+	IRReturn* ret = i + 1 < body.size() ? dynamic_cast<IRReturn*>(body[i + 1]) : nullptr;
+	if (call == nullptr || ret == nullptr || name == "main" || context.intrinsics->provides(call->name))
+	    return false;
+
+	IRVar* dest = dynamic_cast<IRVar*>(call->dest);
+	IRVar* value = dynamic_cast<IRVar*>(ret->val);
+	if (dest == nullptr || value == nullptr || dest->id != value->id || call->args.size() > params.size())
+	    return false;
+
+	// the params were copied out of the slots on entry, so nothing reads them
+	for (int j = 0; j < call->args.size(); j++)
+	    result.push_back(new ASMLoad(new ASMStack(-3 - j), call->args[j]->to_asm()));
+	result.push_back(new ASMTailCall(call->name));
+	return true;
     }
 };
 
@@ -355,15 +493,15 @@ public:
 	}
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	vector<ASMFunction*> asm_body;
 
 	for (IRFunction* f  : functions) {
-	    f->emit(asm_body);
+	    f->emit(asm_body, context);
 	}
 	
-	ASMProgram* asm_prog = new ASMProgram(asm_body);
+	ASMProgram* asm_prog = new ASMProgram(asm_body, context.intrinsics);
         result.push_back(asm_prog);
     }
 };
@@ -379,6 +517,13 @@ public:
 	dest(_dest),
 	src(_src)
     {}
+
+    virtual IROpcode opcode() { return IR_NOP; }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(opcode(), dest->to_value(code), src->to_value(code)));
+    }
 };
 
 class IRBinary : public IRExpr
@@ -394,6 +539,46 @@ public:
 	src1(_src1),
 	src2(_src2)
     {}
+
+    virtual IROpcode opcode() { return IR_NOP; }
+
+    virtual void encode(IRCode& code)
+    {
+	code.push_back(IRInst(opcode(), dest->to_value(code), src1->to_value(code), src2->to_value(code)));
+    }
+
+    // for the operators the machine has no instruction for: calls the
+    // intrinsic name with src1 in r1 and src2 in r2, the result is in out
+    void emit_intrinsic_call(vector<ASMNode*>& result, CompileContext& context, string name, Register out)
+    {
+	require_intrinsic(context, name);
+
+	result.push_back(new ASMLoad(new ASMRegister(r1), src1->to_asm()));
+	result.push_back(new ASMLoad(new ASMRegister(r2), src2->to_asm()));
+	result.push_back(new ASMCall(name, 2));
+	result.push_back(new ASMLoad(dest->to_asm(), new ASMRegister(out)));
+    }
+
+    void require_intrinsic(CompileContext& context, string name)
+    {
+	if (!context.intrinsics->provides(name))
+	    throw CompileError("no intrinsic " + name + " to compute " + opcode_name(opcode()) + " with", 0, 0, 0);
+    }
+
+    // k if src2 is a constant 2^k or -2^k, k from 1 to 14, else 0
+    int divisor_shift()
+    {
+	IRConst* divisor = dynamic_cast<IRConst*>(src2);
+	if (divisor == nullptr)
+	    return 0;
+
+	int magnitude = abs((short)divisor->value);
+	for (int k = 1; k <= 14; k++) {
+	    if (magnitude == 1 << k)
+		return k;
+	}
+	return 0;
+    }
 };
 
 class IRNeg : public IRUnary
@@ -404,6 +589,8 @@ public:
 	IRUnary(_dest, _src)
     {}
 
+    virtual IROpcode opcode() { return IR_NEG; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Neg(";
@@ -413,7 +600,7 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMNeg(dest->to_asm(), src->to_asm()));
     }
@@ -427,6 +614,8 @@ public:
 	IRUnary(_dest, _src)
     {}
 
+    virtual IROpcode opcode() { return IR_NOT; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Not(";
@@ -436,7 +625,7 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMNot(dest->to_asm(), src->to_asm()));
     }
@@ -450,6 +639,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_ADD; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Add(";
@@ -461,7 +652,7 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMAdd(dest->to_asm(), src1->to_asm(), src2->to_asm()));
     }
@@ -475,6 +666,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_SUB; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Sub(";
@@ -486,7 +679,7 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMSub(dest->to_asm(), src1->to_asm(), src2->to_asm()));
     }
@@ -500,6 +693,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_MUL; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Mul(";
@@ -511,9 +706,15 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	result.push_back(new ASMMul(dest->to_asm(), src1->to_asm(), src2->to_asm()));
+	// a constant factor is done inline
+	if (IRConst* factor = dynamic_cast<IRConst*>(src2))
+	    result.push_back(new ASMMulConst(dest->to_asm(), src1->to_asm(), factor->value));
+	else if (IRConst* factor = dynamic_cast<IRConst*>(src1))
+	    result.push_back(new ASMMulConst(dest->to_asm(), src2->to_asm(), factor->value));
+	else
+	    emit_intrinsic_call(result, context, "__f_mul", r0);
     }
 };
 
@@ -525,6 +726,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_DIV; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Div(";
@@ -536,9 +739,33 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	result.push_back(new ASMDiv(dest->to_asm(), src1->to_asm(), src2->to_asm()));
+	int k = divisor_shift();
+	if (k == 0)
+	{
+	    emit_intrinsic_call(result, context, "__f_div", r0);
+	    return;
+	}
+	require_intrinsic(context, "__f_sar");
+
+	// a shift rounds down, so a negative numerator gets 2^k - 1 added first to round towards 0
+	string negative = context.uniq_label();
+	string shift = context.uniq_label();
+	result.push_back(new ASMCmp(src1->to_asm(), new ASMImmediate(0)));
+	result.push_back(new ASMJumpLess(negative));
+	result.push_back(new ASMLoad(new ASMRegister(r1), src1->to_asm()));
+	result.push_back(new ASMJump(shift));
+	result.push_back(new ASMLabel(negative));
+	result.push_back(new ASMAdd(new ASMRegister(r1), src1->to_asm(), new ASMImmediate((1 << k) - 1)));
+	result.push_back(new ASMLabel(shift));
+	result.push_back(new ASMLoad(new ASMRegister(r2), new ASMImmediate(k)));
+	result.push_back(new ASMCall("__f_sar", 2));
+
+	if (((IRConst*)src2)->value < 0)
+	    result.push_back(new ASMNeg(dest->to_asm(), new ASMRegister(r0)));
+	else
+	    result.push_back(new ASMLoad(dest->to_asm(), new ASMRegister(r0)));
     }
 };
 
@@ -550,6 +777,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_MOD; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Mod(";
@@ -561,9 +790,28 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	result.push_back(new ASMMod(dest->to_asm(), src1->to_asm(), src2->to_asm()));
+	int k = divisor_shift();
+	if (k == 0)
+	{
+	    emit_intrinsic_call(result, context, "__f_div", r8);
+	    return;
+	}
+
+	// the remainder takes the sign of src1, so a negative one is masked as -src1
+	string negative = context.uniq_label();
+	string end = context.uniq_label();
+	ASMImmediate* mask = new ASMImmediate((1 << k) - 1);
+	result.push_back(new ASMCmp(src1->to_asm(), new ASMImmediate(0)));
+	result.push_back(new ASMJumpLess(negative));
+	result.push_back(new ASMBitAnd(dest->to_asm(), src1->to_asm(), mask));
+	result.push_back(new ASMJump(end));
+	result.push_back(new ASMLabel(negative));
+	result.push_back(new ASMNeg(dest->to_asm(), src1->to_asm()));
+	result.push_back(new ASMBitAnd(dest->to_asm(), dest->to_asm(), mask));
+	result.push_back(new ASMNeg(dest->to_asm(), dest->to_asm()));
+	result.push_back(new ASMLabel(end));
     }
 };
 
@@ -575,6 +823,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_BITAND; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "BitAnd(";
@@ -586,7 +836,7 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
 	result.push_back(new ASMBitAnd(dest->to_asm(), src1->to_asm(), src2->to_asm()));
     }
@@ -600,6 +850,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_EQUAL; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Equal(";
@@ -611,10 +863,10 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string equal_label = uniq_label();
-	string end_label = uniq_label();
+	string equal_label = context.uniq_label();
+	string end_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(src1->to_asm(), src2->to_asm()));
 	result.push_back(new ASMJumpZero(equal_label));
@@ -635,6 +887,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_UNEQUAL; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Unequal(";
@@ -646,10 +900,10 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string equal_label = uniq_label();
-	string end_label = uniq_label();
+	string equal_label = context.uniq_label();
+	string end_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(src1->to_asm(), src2->to_asm()));
 	result.push_back(new ASMJumpZero(equal_label));
@@ -670,6 +924,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_GREATER_EQUAL; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "GreaterEqual(";
@@ -681,10 +937,10 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string fail_label = uniq_label();
-	string end_label = uniq_label();
+	string fail_label = context.uniq_label();
+	string end_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(src1->to_asm(), src2->to_asm()));
 	result.push_back(new ASMJumpLess(fail_label));
@@ -705,6 +961,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_LESS_EQUAL; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "LessEqual(";
@@ -716,10 +974,10 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string fail_label = uniq_label();
-	string end_label = uniq_label();
+	string fail_label = context.uniq_label();
+	string end_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(src1->to_asm(), src2->to_asm()));
 	result.push_back(new ASMJumpGreater(fail_label));
@@ -740,6 +998,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_LESS; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Less(";
@@ -751,10 +1011,10 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string success_label = uniq_label();
-	string end_label = uniq_label();
+	string success_label = context.uniq_label();
+	string end_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(src1->to_asm(), src2->to_asm()));
 	result.push_back(new ASMJumpLess(success_label));
@@ -776,6 +1036,8 @@ public:
 	IRBinary(_dest, _src1, _src2)
     {}
 
+    virtual IROpcode opcode() { return IR_GREATER; }
+
     virtual void pretty_print(ostream& out)
     {
 	out << "Greater(";
@@ -787,10 +1049,10 @@ public:
 	out << ")" << endl;
     }
 
-    virtual void emit(vector<ASMNode*>& result)
+    virtual void emit(vector<ASMNode*>& result, CompileContext& context)
     {
-	string success_label = uniq_label();
-	string end_label = uniq_label();
+	string success_label = context.uniq_label();
+	string end_label = context.uniq_label();
 	
 	result.push_back(new ASMCmp(src1->to_asm(), src2->to_asm()));
 	result.push_back(new ASMJumpGreater(success_label));
@@ -0,0 +1,57 @@
+#include "tailcalls.hpp"
+
+using namespace std;
+
+int eliminate_tail_recursion(IRCode& code)
+{
+    code.compact();
+
+    vector<int> sites;
+    for (int i = 0; i + 1 < code.insts.size(); i++) {
+	IRInst& call = code.insts[i];
+	IRInst& ret = code.insts[i + 1];
+	if (call.op == IR_CALL && code.labels[call.src1.id] == code.name
+	    && code.call_args[call.src2.id].size() == code.num_params
+	    && ret.op == IR_RETURN && call.dest.is_vreg() && ret.src1 == call.dest)
+	    sites.push_back(i);
+    }
+    if (sites.empty())
+	return 0;
+
+    // the params are read from the stack before the body, so the loop
+    // starts after that. It may already be there from an earlier call,
+    // with a preheader in front of it
+    IRValue start = code.label(code.name + ".tail");
+    bool has_start = false;
+    for (IRInst& inst : code.insts)
+	has_start |= inst.op == IR_LABEL && inst.dest == start;
+
+    vector<IRInst> insts;
+    if (!has_start)
+	insts.push_back(IRInst(IR_LABEL, start));
+
+    int next = 0;
+    for (int i = 0; i < code.insts.size(); i++) {
+	if (next == sites.size() || sites[next] != i)
+	{
+	    insts.push_back(code.insts[i]);
+	    continue;
+	}
+
+	vector<IRValue> args = code.call_args[code.insts[i].src2.id];
+	vector<IRValue> temps;
+	for (IRValue arg : args) {
+	    temps.push_back(code.new_vreg("tail"));
+	    insts.push_back(IRInst(IR_LOAD, temps.back(), arg));
+	}
+	for (int p = 0; p < code.num_params; p++)
+	    insts.push_back(IRInst(IR_LOAD, IRValue::vreg(p), temps[p]));
+	insts.push_back(IRInst(IR_JUMP, IRValue(), start));
+
+	i++;			// the return
+	next++;
+    }
+    code.insts = insts;
+
+    return sites.size();
+}
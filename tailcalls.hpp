@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ircode.hpp"
+
+// Tail recursion elimination on the TACKY of one function.
+//
+// A call of the function to itself whose result is returned right away
+// becomes a loop: the args are copied into the params (through temps,
+// as an arg may read a param another one writes) and a jump goes back
+// to a label at the start of the body. Tail calls to other functions
+// are left to codegen, which jumps to the callee in place of a return.
+//
+// Returns the number of calls turned into jumps.
+int eliminate_tail_recursion(IRCode& code);
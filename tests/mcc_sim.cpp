@@ -0,0 +1,162 @@
+// mcc_sim - runs a Mentat memory image, for the tests
+//
+// Loads an image made by mcc --emit=hex or mcc-ld at 0x8000 and runs it
+// until hlt. Every text the display shows before it is cleared is
+// printed as one line, then the value main returned in r0.
+//
+// The stack grows down and rsp points at the next free word: a push
+// stores, then decrements. A call pushes the address after it. cmp
+// compares A and B as signed numbers, je and jz jump if they were equal.
+// The first word of a two word instruction (pushr, popr, subr, ret)
+// does nothing on its own, the second one does the work.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../assembler.hpp"
+#include "../CLI11.hpp"
+#include "../mcc.hpp"
+
+using namespace std;
+
+class Machine
+{
+public:
+    vector<unsigned short> memory = vector<unsigned short>(0x10000);
+    unsigned short regs[16] = {};
+    unsigned short a = 0, b = 0, sp = 0, pc = IMAGE_ORIGIN;
+    bool equal = false, less = false, greater = false;
+
+    string screen;
+    vector<string> shown;	// what the display showed each time it was cleared
+
+    map<int, pair<string, OperandKind>> decoding;
+
+    Machine(OpcodeTable& table)
+    {
+	for (auto& entry : table.opcodes)
+	    decoding[entry.second.opcode] = {entry.first, entry.second.operands};
+    }
+
+    void load(string image)
+    {
+	for (int i = 0; i + 1 < image.size(); i += 2)
+	    memory[IMAGE_ORIGIN + i / 2] = (unsigned char)image[i] << 8 | (unsigned char)image[i + 1];
+    }
+
+    void clear_screen()
+    {
+	if (!screen.empty())
+	    shown.push_back(screen);
+	screen.clear();
+    }
+
+    // false if it did not halt in time
+    bool run(long max_steps)
+    {
+	string pending;		// the first word of a two word instruction
+	for (long step = 0; step < max_steps; step++) {
+	    int address = pc;
+	    unsigned short word = memory[pc++];
+	    auto it = decoding.find(word >> 8);
+	    if (it == decoding.end())
+		throw runtime_error("unknown opcode " + to_string(word >> 8) + " at " + to_string(address));
+
+	    string name = it->second.first;
+	    OperandKind kind = it->second.second;
+	    unsigned short& r = regs[word & 0xf];
+	    unsigned short operand = kind == IMM_OPERAND || kind == ADDR_OPERAND || kind == REG_IMM_OPERAND ? memory[pc++] : 0;
+
+	    if (name.back() == '2')
+	    {
+		if (pending != name.substr(0, name.size() - 1))
+		    throw runtime_error(name + " without " + name.substr(0, name.size() - 1) + " at " + to_string(address));
+	    }
+	    else if (!pending.empty())
+		throw runtime_error(pending + " without " + pending + "2 at " + to_string(address));
+	    pending.clear();
+
+	    if (name == "pushr" || name == "popr" || name == "subr" || name == "ret")
+		pending = name;
+	    else if (name == "pushr2")		memory[sp--] = r;
+	    else if (name == "popr2")		r = memory[++sp];
+	    else if (name == "subr2")		{ memory[sp--] = pc; pc = operand; }
+	    else if (name == "ret2")		pc = memory[++sp];
+	    else if (name == "hlt")		{ clear_screen(); return true; }
+	    else if (name == "jmp")		pc = operand;
+	    else if (name == "jz" || name == "je") { if (equal) pc = operand; }
+	    else if (name == "jl")		{ if (less) pc = operand; }
+	    else if (name == "jg")		{ if (greater) pc = operand; }
+	    else if (name == "cmp")
+	    {
+		equal = a == b;
+		less = (short)a < (short)b;
+		greater = (short)a > (short)b;
+	    }
+	    else if (name == "add")		a = a + b;
+	    else if (name == "sub")		a = a - b;
+	    else if (name == "and")		a = a & b;
+	    else if (name == "shl")		a = a << 1;
+	    else if (name == "ldai")		a = operand;
+	    else if (name == "ldbi")		b = operand;
+	    else if (name == "ldar")		a = r;
+	    else if (name == "ldbr")		b = r;
+	    else if (name == "ldra")		r = a;
+	    else if (name == "ldrb")		r = b;
+	    else if (name == "ldri")		r = operand;
+	    else if (name == "lds")		sp = operand;
+	    else if (name == "ldrs")		r = sp;
+	    else if (name == "ldsr")		sp = r;
+	    else if (name == "ldas")		a = sp;
+	    else if (name == "ldsa")		sp = a;
+	    else if (name == "ldmaa")		a = memory[a];
+	    else if (name == "ldmra")		memory[a] = r;
+	    else if (name == "ldam")		a = memory[operand];
+	    else if (name == "out")		{ if (operand == 1) clear_screen(); }
+	    else if (name == "outa")		{ if (a & 0x100) screen += (char)(a & 0xff); }
+	    else
+		throw runtime_error("cannot run " + name + " at " + to_string(address));
+	}
+	return false;
+    }
+};
+
+int main(int argc, char** argv)
+{
+    string infile;
+    string opcodes_file;
+    long max_steps = 10000000;
+
+    CLI::App app{"mcc_sim - runs a Mentat memory image and prints what it displayed"};
+    app.add_option("input", infile, "The hex file")->required();
+    app.add_option("--opcodes", opcodes_file, "Table of extra instruction encodings");
+    app.add_option("--max-steps", max_steps, "Give up after this many instructions");
+    CLI11_PARSE(app, argc, argv);
+
+    try {
+	OpcodeTable table;
+	if (!opcodes_file.empty())
+	    table.load(read_file(opcodes_file));
+
+	Machine machine(table);
+	machine.load(read_file(infile));
+	bool halted = machine.run(max_steps);
+
+	for (string& text : machine.shown)
+	    cout << text << endl;
+	if (!halted)
+	{
+	    cerr << "mcc_sim: did not halt after " << max_steps << " instructions" << endl;
+	    return 1;
+	}
+	cout << "exit " << (short)machine.regs[0] << endl;
+    } catch (exception& error) {
+	cerr << "mcc_sim: " << error.what() << endl;
+	return 1;
+    }
+}
@@ -0,0 +1,134 @@
+#!/bin/sh
+# run by make check from the top directory
+#
+#   asm_test/*/*.s        must assemble to the image next to it, which mas made
+#   tests/programs/X.mc   must display what X.out says when run by mcc_sim,
+#                         without and with optimization, and when compiled
+#                         with -c and linked by mcc-ld
+#   tests/link/*.mc       are compiled one by one and linked together,
+#                         then must display what expected.out says
+#
+# The programs that test an optimization would display the same with the
+# pass turned off, so each of them also checks that its pass did something,
+# from the mcc -s statistics or from the assembly of one function.
+#
+# mcc only knows the encodings checked against mas, the programs get the
+# rest from tests/opcodes.txt, which the simulator decodes with as well
+
+failed=0
+opcodes=tests/opcodes.txt
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+fail()
+{
+    echo "FAIL $1"
+    failed=1
+}
+
+# the -O1 assembly of one function of a test program, fails if it is not there
+function_asm()
+{
+    ./mcc -O1 -i "tests/programs/$1.mc" -o "$work/opt.s" &&
+	awk -v f="$2:" '$0 == f {found = on = 1; next}
+	    /^[A-Za-z_][A-Za-z0-9_]*:$/ && $0 !~ /^label[0-9]+:$/ {on = 0}
+	    on; END {exit !found}' "$work/opt.s"
+}
+
+# program stat: mcc -O1 -s counts more than 0 for stat
+expect_stat()
+{
+    count=$(./mcc -O1 -s -i "tests/programs/$1.mc" -o "$work/opt.s" 2>&1 | awk -v s="$2" '$1 == "stat" && $2 == s {print $3}')
+    if [ "${count:-0}" -gt 0 ]; then
+	echo "ok   tests/programs/$1.mc $2 $count"
+    else
+	fail "tests/programs/$1.mc $2 is ${count:-not reported}"
+    fi
+}
+
+# program function pattern: the function has (has_asm) or has not (lacks_asm) the pattern
+has_asm()
+{
+    if function_asm "$1" "$2" > "$work/function.s" && grep -q "$3" "$work/function.s"; then
+	echo "ok   tests/programs/$1.mc $2 has $3"
+    else
+	fail "tests/programs/$1.mc $2 has no $3"
+    fi
+}
+
+lacks_asm()
+{
+    if function_asm "$1" "$2" > "$work/function.s" && ! grep -q "$3" "$work/function.s"; then
+	echo "ok   tests/programs/$1.mc $2 has no $3"
+    else
+	fail "tests/programs/$1.mc $2 has $3, or is not there"
+    fi
+}
+
+# runs an image and compares what it displayed with the expected output
+check_run()
+{
+    if ./tests/mcc_sim --opcodes $opcodes "$1" > "$work/run.out" && cmp -s "$work/run.out" "$2"; then
+	return 0
+    fi
+    diff "$2" "$work/run.out"
+    return 1
+}
+
+for source in asm_test/*/*.s; do
+    image=$(ls "${source%/*}"/*.hex)
+    if ./mcc -i "$source" -o "$work/image.hex" && cmp -s "$work/image.hex" "$image"; then
+	echo "ok   $source"
+    else
+	fail "$source does not assemble to $image"
+    fi
+done
+
+for source in tests/programs/*.mc; do
+    expected=${source%.mc}.out
+    for level in 0 1; do
+	if ./mcc -O$level --opcodes $opcodes -i "$source" --emit=hex -o "$work/image.hex" && check_run "$work/image.hex" "$expected"; then
+	    echo "ok   $source -O$level"
+	else
+	    fail "$source -O$level"
+	fi
+    done
+
+    if ./mcc --opcodes $opcodes -i "$source" -c -o "$work/object.o" && ./mcc-ld --opcodes $opcodes "$work/object.o" -o "$work/image.hex" && check_run "$work/image.hex" "$expected"; then
+	echo "ok   $source -c"
+    else
+	fail "$source -c"
+    fi
+done
+
+expect_stat fold combine.simplified
+expect_stat copies copies.propagated
+expect_stat dce dce.removed
+lacks_asm dataflow overwritten_on_both_paths __f_mul
+expect_stat sccp sccp.replaced
+expect_stat gvn cse.eliminated
+expect_stat licm licm.hoisted
+expect_stat ivs iv.reduced
+lacks_asm ivs series __f_mul
+has_asm muldiv main "subr2 __f_mul"
+has_asm muldiv main "subr2 __f_div"
+lacks_asm const_muldiv by_constants __f_mul
+lacks_asm inline main "subr2 clamp"
+lacks_asm inline main "subr2 twice"
+expect_stat tailcalls tail.recursion
+lacks_asm tailcalls rotate "subr2 rotate"
+lacks_asm frames leaf "pushr %r15"
+
+objects=""
+for source in tests/link/*.mc; do
+    object="$work/$(basename "$source" .mc).o"
+    ./mcc --opcodes $opcodes -i "$source" -c -o "$object" || fail "$source -c"
+    objects="$objects $object"
+done
+if ./mcc-ld --opcodes $opcodes $objects -o "$work/image.hex" && check_run "$work/image.hex" tests/link/expected.out; then
+    echo "ok   tests/link"
+else
+    fail "tests/link"
+fi
+
+exit $failed
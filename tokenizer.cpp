@@ -2,9 +2,9 @@
 #include <string>
 #include <regex>
 #include <deque>
-#include <iostream>
 
 #include "tokenizer.h"
+#include "mcc.hpp"
 
 using namespace std;
 
@@ -100,8 +100,7 @@ deque<token> tokenize(string input)
 	}
 	else
 	{
-	    cout << "Unrecognized Token: '" << input.substr(0, 20)  << "'" << endl;
-	    break;
+	    throw CompileError("Unrecognized Token: '" + input.substr(0, 20) + "'", line_number, string_pos, string_pos + 1);
 	}
 	
 